@@ -30,7 +30,11 @@ struct Config {
 	uint32_t threadCount{0};
 	uint32_t serializeThreadCount{0};
 	uint32_t compactLevel{std::numeric_limits<uint32_t>::max()};
+	std::size_t payloadCacheBytes{std::size_t(1) << 30};
+	hic::Static::OscarSearchHCQRTextIndexCreator::TreeFormat treeFormat{hic::Static::OscarSearchHCQRTextIndexCreator::TF_HCQR_SPATIAL_GRID};
 	bool onlyLeafs{false};
+	bool itemTrixels{false};
+	bool regionExclusiveTrixels{false};
     std::string filename;
     std::string outdir;
 	IndexType it{IT_HTM};
@@ -53,10 +57,14 @@ void help() {
 		"\t-f <oscar files>\n"
 		"\t--index-type (htm|h3|simplegrid|s2geom)\n"
 		"\t-l <levels>\n"
+		"\t--item-trixels\n"
+		"\t--region-exclusive-trixels\n"
 		"hcqr-mode:\n"
 		"\t-f <sg files>\n"
-		"\t--compactify <max level>"
-		"\t--only-leafs"
+		"\t--compactify <max level>\n"
+		"\t--only-leafs\n"
+		"\t--payload-cache <bytes of serialized trees kept for reuse, 0 disables reuse, serialized and succinct trees are reused by reference>\n"
+		"\t--tree-format (sg|serialized|succinct): serialized and succinct write search.shcqr for the sg files, no compactification. Queries decode succinct trees in full\n"
 	<< std::flush;
 }
 
@@ -117,7 +125,14 @@ int createSpatialGrid(Config & cfg) {
     oshi->idxFactory().setIndexFile(state.indexFile);
     
     std::cout << "Serializing search structures..." << std::endl;
-    oshi->create(state.searchFile, cfg.serializeThreadCount);
+    int creationFlags = hic::OscarSearchSgIndex::CF_NONE;
+    if (cfg.itemTrixels) {
+        creationFlags |= hic::OscarSearchSgIndex::CF_ITEM_TRIXELS;
+    }
+    if (cfg.regionExclusiveTrixels) {
+        creationFlags |= hic::OscarSearchSgIndex::CF_REGION_EXCLUSIVE_TRIXELS;
+    }
+    oshi->create(state.searchFile, cfg.serializeThreadCount, creationFlags);
     oshi->idxFactory().flush();
     std::cout << "done" << std::endl;
 
@@ -139,11 +154,18 @@ int createHCQR(Config & cfg) {
 	hic::Static::OscarSearchHCQRTextIndexCreator cc;
 	cc.threads = cfg.serializeThreadCount;
 	cc.compactTree = cfg.onlyLeafs;
+	cc.payloadCacheBytes = cfg.payloadCacheBytes;
+	cc.treeFormat = cfg.treeFormat;
 	if (cfg.compactLevel != std::numeric_limits<uint32_t>::max()) {
 		cc.compactify = true;
 		cc.compactLevel = cfg.compactLevel;
 	}
-	cc.dest = sserialize::UByteArrayAdapter::createFile(0, cfg.outdir + "/search.hcqr");
+	if (cfg.treeFormat == hic::Static::OscarSearchHCQRTextIndexCreator::TF_HCQR_SPATIAL_GRID) {
+		cc.dest = sserialize::UByteArrayAdapter::createFile(0, cfg.outdir + "/search.hcqr");
+	}
+	else {
+		cc.dest = sserialize::UByteArrayAdapter::createFile(0, cfg.outdir + "/search.shcqr");
+	}
 	cc.src = sserialize::UByteArrayAdapter::openRo(cfg.filename + "/search", false);
 	cc.idxStore = sserialize::Static::ItemIndexStore(sserialize::UByteArrayAdapter::openRo(cfg.filename + "/index", false));
 	cc.idxFactory.setIndexFile(sserialize::UByteArrayAdapter::createFile(0, cfg.outdir + "/index"));
@@ -233,9 +255,37 @@ int main(int argc, char const * argv[] ) {
 			cfg.compactLevel = std::atoi(argv[i+1]);
 			++i;
 		}
+		else if (token == "--payload-cache" && i+1 < argc) {
+			cfg.payloadCacheBytes = std::strtoull(argv[i+1], nullptr, 10);
+			++i;
+		}
+		else if (token == "--tree-format" && i+1 < argc) {
+			std::string fmt(argv[i+1]);
+			if (fmt == "sg") {
+				cfg.treeFormat = hic::Static::OscarSearchHCQRTextIndexCreator::TF_HCQR_SPATIAL_GRID;
+			}
+			else if (fmt == "serialized") {
+				cfg.treeFormat = hic::Static::OscarSearchHCQRTextIndexCreator::TF_SERIALIZED_HCQR;
+			}
+			else if (fmt == "succinct") {
+				cfg.treeFormat = hic::Static::OscarSearchHCQRTextIndexCreator::TF_SUCCINCT_HCQR;
+			}
+			else {
+				std::cerr << "Unknown tree format: " << fmt << std::endl;
+				help();
+				return -1;
+			}
+			++i;
+		}
 		else if (token == "--only-leafs") {
 			cfg.onlyLeafs = true;
 		}
+		else if (token == "--item-trixels") {
+			cfg.itemTrixels = true;
+		}
+		else if (token == "--region-exclusive-trixels") {
+			cfg.regionExclusiveTrixels = true;
+		}
         else {
             std::cerr << "Unkown parameter: " << token << std::endl;
 			help();
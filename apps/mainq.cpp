@@ -1,5 +1,7 @@
 #include <ostream>
+#include <fstream>
 #include <chrono>
+#include <unordered_set>
 
 #include <liboscar/StaticOsmCompleter.h>
 #include <sserialize/stats/TimeMeasuerer.h>
@@ -11,14 +13,23 @@
 #include <hic/static-htm-index.h>
 #include <hic/HCQRCompleter.h>
 #include <hic/GeoHierarchyHCQRCompleter.h>
+#include <hic/SerializedHcqrIndex.h>
 
 struct Config {
     std::string oscarFiles;
     std::string htmFiles;
 	std::string shcqrFiles;
+	///directory with the search.shcqr of the spatial grid files
+	std::string serializedHcqrFiles;
 	bool staticHCQR{false};
 	bool compactifiedHCQR{false};
 	uint32_t cachedHCQR{0};
+	///query log replayed by all hcqr completers on startup
+	std::string hcqrWarmUpFile;
+	///file the queries of all hcqr completers are written to before exiting
+	std::string hcqrQueryLogFile;
+	///maximum number of recorded queries per hcqr completer
+	uint32_t hcqrQueryLogSize{1 << 16};
 };
 
 struct WorkData {
@@ -55,6 +66,13 @@ struct WorkDataBenchmark: public WorkData {
 	uint32_t threadCount;
 };
 
+struct WorkDataPage: public WorkData {
+	WorkDataPage(uint32_t offset, uint32_t limit) : offset(offset), limit(limit) {}
+	virtual ~WorkDataPage() override {}
+	uint32_t offset;
+	uint32_t limit;
+};
+
 using WorkDataString = WorkDataSingleValue<std::string>;
 using WorkDataU32 = WorkDataSingleValue<uint32_t>;
 
@@ -64,10 +82,16 @@ struct WorkItem {
 		WI_BENCHMARK,
 		WI_NUM_THREADS,
 		WI_NUM_ITEMS,
+		WI_TIMEOUT,
+		WI_MAX_LEVEL,
         WI_SG_CQR,
         WI_SG_TCQR,
+		WI_SG_COUNT,
+		WI_SG_COUNT_ESTIMATE,
+		WI_SG_PAGE,
 		WI_SG_HCQR,
 		WI_SG_SHCQR,
+		WI_SG_SERIALIZED_HCQR,
         WI_OSCAR_CQR,
         WI_OSCAR_TCQR,
 		WI_OSCAR_HCQR,
@@ -87,6 +111,13 @@ struct State {
     std::string str;
 	int numItems{0};
 	uint32_t numThreads{1};
+	///in milliseconds, 0 disables the timeout
+	uint32_t timeout{0};
+	hic::Deadline deadline() const {
+		return timeout ? hic::Deadline(std::chrono::milliseconds(timeout)) : hic::Deadline();
+	}
+	///Level of detail of hierarchical results
+	uint32_t maxLevel{hic::HcqrOpTree::NoMaxLevel};
 };
 
 struct HtmState {
@@ -107,6 +138,7 @@ struct Completers {
 	std::shared_ptr<hic::HCQRCompleter> hsgcmp;
 	std::shared_ptr<hic::HCQRCompleter> hocmp;
 	std::shared_ptr<hic::HCQRCompleter> shcmp;
+	sserialize::RCPtrWrapper<hic::Static::SerializedHcqrTextIndex> srcmp;
 };
 
 struct QueryStats {
@@ -123,6 +155,13 @@ struct HQueryStats {
 	sserialize::TimeMeasurer flatenTime;
 };
 
+struct SQueryStats {
+	hic::SerializedHcqr hcqr;
+	sserialize::ItemIndex items;
+	sserialize::TimeMeasurer cqrTime;
+	sserialize::TimeMeasurer flatenTime;
+};
+
 template<typename T_OUTPUT_ITERATOR>
 void readCompletionStringsFromFile(const std::string & fileName, T_OUTPUT_ITERATOR out) {
 	std::string tmp;
@@ -156,6 +195,22 @@ std::ostream & operator<<(std::ostream & out, HQueryStats const & qs) {
 	return out;
 }
 
+std::ostream & operator<<(std::ostream & out, SQueryStats const & qs) {
+	out << "# nodes: " << qs.hcqr.numberOfNodes() << '\n';
+	out << "Size: " << qs.hcqr.data().size() << " Bytes\n";
+	out << "Set op time: " << qs.cqrTime << '\n';
+	out << "Items time (query and items): " << qs.flatenTime << '\n';
+	out << "# items: " << qs.items.size() << '\n';
+	return out;
+}
+
+///Ends timer of a query that timed out and reports it
+void reportTimeout(sserialize::TimeMeasurer & timer, std::string const & title, std::string const & query, hic::TimeoutException const & e) {
+	timer.end();
+	std::cout << title << ": " << query << std::endl;
+	std::cout << "Timed out after " << timer << ": " << e.what() << '\n' << std::endl;
+}
+
 std::string const meas_res_unit{"us"};
 
 struct Stats {
@@ -205,16 +260,16 @@ void benchmark(Completers & completers, WorkDataBenchmark const & cfg) {
 		if (cfg.hcqr) {
 			for(std::size_t i(0), s(queries.size()); i < s; ++i) {
 				{ //no static hcqr support yet. Instead this will use the cached files. 
-					auto dummy = completers.hsgcmp->complete(queries[i]);
+					auto dummy = completers.hsgcmp->complete(queries[i], cfg.threadCount);
 				}
 				
 				auto start = std::chrono::high_resolution_clock::now();
-				auto sg_hcqr = completers.hsgcmp->complete(queries[i]);
+				auto sg_hcqr = completers.hsgcmp->complete(queries[i], cfg.threadCount);
 				auto stop = std::chrono::high_resolution_clock::now();
 				sg_stats.cqr.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 				
 				start = std::chrono::high_resolution_clock::now();
-				auto sg_items = (sg_hcqr ? sg_hcqr->items() : sserialize::ItemIndex());
+				auto sg_items = completers.hsgcmp->items(sg_hcqr, cfg.threadCount);
 				stop = std::chrono::high_resolution_clock::now();
 				sg_stats.flaten.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 				sg_stats.cellCount.emplace_back((sg_hcqr ? sg_hcqr->numberOfNodes() : 0));
@@ -275,15 +330,15 @@ void benchmark(Completers & completers, WorkDataBenchmark const & cfg) {
 		if (cfg.hcqr) {
 			for(std::size_t i(0), s(queries.size()); i < s; ++i) {
 				{
-					auto dummy = completers.hocmp->complete(queries[i]);
+					auto dummy = completers.hocmp->complete(queries[i], cfg.threadCount);
 				}
 				auto start = std::chrono::high_resolution_clock::now();
-				auto o_hcqr = completers.hocmp->complete(queries[i]);
+				auto o_hcqr = completers.hocmp->complete(queries[i], cfg.threadCount);
 				auto stop = std::chrono::high_resolution_clock::now();
 				o_stats.cqr.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 				
 				start = std::chrono::high_resolution_clock::now();
-				auto o_items = (o_hcqr ? o_hcqr->items() : sserialize::ItemIndex());
+				auto o_items = completers.hocmp->items(o_hcqr, cfg.threadCount);
 				stop = std::chrono::high_resolution_clock::now();
 				o_stats.flaten.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 				o_stats.cellCount.emplace_back((o_hcqr ? o_hcqr->numberOfNodes() : 0));
@@ -338,12 +393,12 @@ void benchmark(Completers & completers, WorkDataBenchmark const & cfg) {
 		pinfo.begin(queries.size(), "Computing sg queries");
 		for(std::size_t i(0), s(queries.size()); i < s; ++i) {
 			auto start = std::chrono::high_resolution_clock::now();
-			auto hcqr = completers.shcmp->complete(queries[i]);
+			auto hcqr = completers.shcmp->complete(queries[i], cfg.threadCount);
 			auto stop = std::chrono::high_resolution_clock::now();
 			stats.cqr.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 			
 			start = std::chrono::high_resolution_clock::now();
-			auto items = (hcqr ? hcqr->items() : sserialize::ItemIndex());
+			auto items = completers.shcmp->items(hcqr, cfg.threadCount);
 			stop = std::chrono::high_resolution_clock::now();
 			stats.flaten.emplace_back(std::chrono::duration_cast<Stats::meas_res>(stop-start).count());
 			stats.cellCount.emplace_back((hcqr ? hcqr->numberOfNodes() : 0));
@@ -403,14 +458,14 @@ void debugDiff(State const & state, Completers & completers) {
 		tsq = completers.sgcmp->complete(state.str, true, state.numThreads).flaten(state.numThreads);
 	}
 	if (completers.hsgcmp) {
-		hsq = completers.hsgcmp->complete(state.str)->items();
+		hsq = completers.hsgcmp->items(completers.hsgcmp->complete(state.str, state.numThreads), state.numThreads);
 	}
 	if (completers.cmp) {
 		oq = completers.cmp->cqrComplete(state.str, false, state.numThreads).flaten(state.numThreads);
 		toq = completers.cmp->cqrComplete(state.str, true, state.numThreads).flaten(state.numThreads);
 	}
 	if (completers.hsgcmp) {
-		hoq = completers.hsgcmp->complete(state.str)->items();
+		hoq = completers.hsgcmp->items(completers.hsgcmp->complete(state.str, state.numThreads), state.numThreads);
 	}
 	
 	sdiff = sq ^ tsq;
@@ -482,7 +537,7 @@ void debugDiff(State const & state, Completers & completers) {
 }
 
 void help() {
-	std::cerr << "prg -o <oscar files> -g <spatial grid files> -s <static hcqr files> --hcqr-cache <number> --static-hcqr --compact-hcqr  -m <query string> -t <number of threads> -sq -tsq -hsq -shq -oq -toq -hoq --preload --benchmark <query file> <raw stats prefix> <treedCQR=true|false> <hcqr=true|false> <threadCount> --stats --debug-diff" << std::endl;
+	std::cerr << "prg -o <oscar files> -g <spatial grid files> -s <static hcqr files> --hcqr-cache <number> --hcqr-warmup <query log> --hcqr-dump <query log> --serialized-hcqr <serialized hcqr files> --static-hcqr --compact-hcqr  -m <query string> -t <number of threads> --timeout <milliseconds> --hcqr-lod <max level> -sq -tsq -csq -ecsq -psq <offset> <limit> -hsq -shq -srq -oq -toq -hoq --preload --benchmark <query file> <raw stats prefix> <treedCQR=true|false> <hcqr=true|false> <threadCount> --stats --debug-diff" << std::endl;
 }
 
 sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQRIndex> applyCfg(sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQRIndex> index, Config const & cfg) {
@@ -519,10 +574,22 @@ int main(int argc, char const * argv[]) {
             cfg.shcqrFiles = std::string(argv[i+1]);
             ++i;
         }
+        else if (token == "--serialized-hcqr" && i+1 < argc) {
+            cfg.serializedHcqrFiles = std::string(argv[i+1]);
+            ++i;
+        }
         else if (token == "--hcqr-cache" && i+1 < argc) {
 			cfg.cachedHCQR = std::atoi(argv[i+1]);
 			++i;
 		}
+		else if (token == "--hcqr-warmup" && i+1 < argc) {
+			cfg.hcqrWarmUpFile = std::string(argv[i+1]);
+			++i;
+		}
+		else if (token == "--hcqr-dump" && i+1 < argc) {
+			cfg.hcqrQueryLogFile = std::string(argv[i+1]);
+			++i;
+		}
 		else if (token == "--compact-hcqr") {
 			cfg.compactifiedHCQR = true;
 		}
@@ -537,6 +604,14 @@ int main(int argc, char const * argv[]) {
 			state.queue.emplace_back(WorkItem::WI_NUM_THREADS, new WorkDataU32(std::atoi(argv[i+1])));
 			++i;
 		}
+		else if (token == "--timeout" && i+1 < argc) {
+			state.queue.emplace_back(WorkItem::WI_TIMEOUT, new WorkDataU32(std::atoi(argv[i+1])));
+			++i;
+		}
+		else if (token == "--hcqr-lod" && i+1 < argc) {
+			state.queue.emplace_back(WorkItem::WI_MAX_LEVEL, new WorkDataU32(std::atoi(argv[i+1])));
+			++i;
+		}
 		else if (token == "-v" && i+1 < argc) {
 			state.queue.emplace_back(WorkItem::WI_NUM_ITEMS, new WorkDataU32(std::atoi(argv[i+1])));
 			++i;
@@ -547,12 +622,25 @@ int main(int argc, char const * argv[]) {
         else if (token == "-tsq") {
             state.queue.emplace_back(WorkItem::WI_SG_TCQR, std::nullptr_t());
         }
+        else if (token == "-csq") {
+            state.queue.emplace_back(WorkItem::WI_SG_COUNT, std::nullptr_t());
+        }
+        else if (token == "-ecsq") {
+            state.queue.emplace_back(WorkItem::WI_SG_COUNT_ESTIMATE, std::nullptr_t());
+        }
+        else if (token == "-psq" && i+2 < argc) {
+            state.queue.emplace_back(WorkItem::WI_SG_PAGE, new WorkDataPage(std::atoi(argv[i+1]), std::atoi(argv[i+2])));
+            i += 2;
+        }
         else if (token == "-hsq") {
             state.queue.emplace_back(WorkItem::WI_SG_HCQR, std::nullptr_t());
         }
         else if (token == "-shq") {
             state.queue.emplace_back(WorkItem::WI_SG_SHCQR, std::nullptr_t());
         }
+        else if (token == "-srq") {
+            state.queue.emplace_back(WorkItem::WI_SG_SERIALIZED_HCQR, std::nullptr_t());
+        }
         else if (token == "-oq") {
             state.queue.emplace_back(WorkItem::WI_OSCAR_CQR, std::nullptr_t());
         }
@@ -647,7 +735,12 @@ int main(int argc, char const * argv[]) {
 		if (needsHCQR) {
 			try {
 				auto base = hic::Static::makeOscarSearchSgHCQRIndex(completers.sgcmp->indexPtr());
-				completers.hsgcmp = std::make_shared<hic::HCQRCompleter>( applyCfg(base, cfg) );
+				//spatial ops create dynamic hcqrs which can not be combined with static ones
+				hic::HCQRCompleter::SpatialOpsPtr so;
+				if (!cfg.staticHCQR) {
+					so = hic::Static::makeOscarSearchSgHCQRSpatialOps(completers.sgcmp->indexPtr());
+				}
+				completers.hsgcmp = std::make_shared<hic::HCQRCompleter>( applyCfg(base, cfg), so );
 			}
 			catch (std::exception const & e) {
 				std::cerr << "Failed to initialize hierachical spatial grid completer: " << e.what() << std::endl;
@@ -655,6 +748,21 @@ int main(int argc, char const * argv[]) {
 			}
 		}
 	}
+	if (cfg.serializedHcqrFiles.size()) {
+		if (!completers.sgcmp) {
+			std::cerr << "Serialized hcqr files need the spatial grid files they were created from" << std::endl;
+			help();
+			return -1;
+		}
+		try {
+			auto d = sserialize::UByteArrayAdapter::openRo(cfg.serializedHcqrFiles + "/search.shcqr", false);
+			completers.srcmp = hic::Static::SerializedHcqrTextIndex::make(d, completers.sgcmp->indexPtr());
+		}
+		catch (std::exception const & e) {
+			std::cerr << "Failed to initialize serialized hcqr index: " << e.what() << std::endl;
+			return -1;
+		}
+	}
 	if (cfg.shcqrFiles.size()) {
 		try {
 			auto isd = sserialize::UByteArrayAdapter::openRo(cfg.shcqrFiles + "/index", false);
@@ -669,11 +777,58 @@ int main(int argc, char const * argv[]) {
 		}
 	}
 
+	for(auto const & x : {completers.hocmp, completers.hsgcmp, completers.shcmp}) {
+		if (x && cfg.hcqrQueryLogFile.size()) {
+			x->recordQueries(cfg.hcqrQueryLogSize);
+		}
+	}
+	
+	//Runs once the settings in front of the first work item using the completers were applied
+	bool warmedUp = !cfg.hcqrWarmUpFile.size();
+	auto warmUp = [&]() {
+		warmedUp = true;
+		for(auto const & x : {completers.hocmp, completers.hsgcmp, completers.shcmp}) {
+			if (!x) {
+				continue;
+			}
+			sserialize::TimeMeasurer tm;
+			tm.begin();
+			try {
+				auto stats = x->warmUp(cfg.hcqrWarmUpFile, state.numThreads);
+				tm.end();
+				std::cout << "Replayed " << stats.replayed << " queries for warm-up in " << tm;
+				std::cout << ", skipped " << stats.unsupported << " unsupported queries" << std::endl;
+				for(std::string const & error : stats.errors) {
+					std::cerr << "Failed to replay warm-up query " << error << std::endl;
+				}
+			}
+			catch (std::exception const & e) {
+				std::cerr << "Failed to warm up hcqr completer: " << e.what() << std::endl;
+			}
+		}
+	};
+
 	QueryStats qs;
 	HQueryStats hqs;
+	SQueryStats sqs;
 	for(uint32_t i(0), s(state.queue.size()); i < s; ++i) {
 		WorkItem & wi = state.queue[i];
 		
+		if (!warmedUp) {
+			switch (wi.type) {
+				case WorkItem::WI_QUERY_STRING:
+				case WorkItem::WI_NUM_THREADS:
+				case WorkItem::WI_NUM_ITEMS:
+				case WorkItem::WI_TIMEOUT:
+				case WorkItem::WI_MAX_LEVEL:
+				case WorkItem::WI_PRELOAD:
+					break;
+				default:
+					warmUp();
+					break;
+			}
+		}
+		
 		switch (wi.type) {
 			case WorkItem::WI_QUERY_STRING:
 				state.str = wi.data->as<WorkDataString>()->value;
@@ -684,6 +839,12 @@ int main(int argc, char const * argv[]) {
 			case WorkItem::WI_NUM_ITEMS:
 				state.numItems = wi.data->as<WorkDataU32>()->value;
 				break;
+			case WorkItem::WI_TIMEOUT:
+				state.timeout = wi.data->as<WorkDataU32>()->value;
+				break;
+			case WorkItem::WI_MAX_LEVEL:
+				state.maxLevel = wi.data->as<WorkDataU32>()->value;
+				break;
 			case WorkItem::WI_SG_CQR:
 			case WorkItem::WI_SG_TCQR:
 			{
@@ -692,7 +853,14 @@ int main(int argc, char const * argv[]) {
 					return -1;
 				}
 				qs.cqrTime.begin();
-				qs.cqr = completers.sgcmp->complete(state.str, wi.type == WorkItem::WI_SG_TCQR, state.numThreads);
+				try {
+					qs.cqr = completers.sgcmp->complete(state.str, wi.type == WorkItem::WI_SG_TCQR, state.numThreads, state.deadline());
+				}
+				catch (hic::TimeoutException const & e) {
+					qs.cqr = sserialize::CellQueryResult();
+					reportTimeout(qs.cqrTime, "Spatial Grid Index query", state.str, e);
+					break;
+				}
 				qs.cqrTime.end();
 				if (state.numItems) {
 					qs.flatenTime.begin();
@@ -703,6 +871,51 @@ int main(int argc, char const * argv[]) {
 				std::cout << qs << std::endl;
 			}
 				break;
+			case WorkItem::WI_SG_COUNT:
+			case WorkItem::WI_SG_COUNT_ESTIMATE:
+			{
+				if (cfg.htmFiles.empty()) {
+					std::cerr << "No spatial grid available" << std::endl;
+					return -1;
+				}
+				auto cm = (wi.type == WorkItem::WI_SG_COUNT ? hic::Static::OscarSearchSgCompleter::CM_EXACT : hic::Static::OscarSearchSgCompleter::CM_ESTIMATE);
+				sserialize::TimeMeasurer tm;
+				tm.begin();
+				uint32_t count = 0;
+				try {
+					count = completers.sgcmp->count(state.str, cm, state.numThreads, state.deadline());
+				}
+				catch (hic::TimeoutException const & e) {
+					reportTimeout(tm, "Spatial Grid Index count query", state.str, e);
+					break;
+				}
+				tm.end();
+				std::cout << "Spatial Grid Index count query: " << state.str << std::endl;
+				std::cout << "# items" << (cm == hic::Static::OscarSearchSgCompleter::CM_ESTIMATE ? " (estimated)" : "") << ": " << count << '\n';
+				std::cout << "Count time: " << tm << '\n' << std::endl;
+			}
+				break;
+			case WorkItem::WI_SG_PAGE:
+			{
+				if (cfg.htmFiles.empty()) {
+					std::cerr << "No spatial grid available" << std::endl;
+					return -1;
+				}
+				auto const & page = *(wi.data->as<WorkDataPage>());
+				sserialize::TimeMeasurer tm;
+				tm.begin();
+				auto items = completers.sgcmp->items(state.str, page.offset, page.limit, state.numThreads);
+				tm.end();
+				std::cout << "Spatial Grid Index paged query: " << state.str << std::endl;
+				std::cout << "offset: " << page.offset << ", limit: " << page.limit << '\n';
+				std::cout << "items:";
+				for(auto x : items) {
+					std::cout << ' ' << x;
+				}
+				std::cout << '\n';
+				std::cout << "Page time: " << tm << '\n' << std::endl;
+			}
+				break;
 			case WorkItem::WI_SG_HCQR:
 			{
 				if (cfg.htmFiles.empty()) {
@@ -710,11 +923,18 @@ int main(int argc, char const * argv[]) {
 					return -1;
 				}
 				hqs.cqrTime.begin();
-				hqs.hcqr = completers.hsgcmp->complete(state.str);
+				try {
+					hqs.hcqr = completers.hsgcmp->complete(state.str, state.numThreads, state.deadline(), state.maxLevel);
+				}
+				catch (hic::TimeoutException const & e) {
+					hqs.hcqr = sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR>();
+					reportTimeout(hqs.cqrTime, "Hierarchical Spatial Grid Index query", state.str, e);
+					break;
+				}
 				hqs.cqrTime.end();
 				if (state.numItems) {
 					hqs.flatenTime.begin();
-					hqs.items = hqs.hcqr->items();
+					hqs.items = completers.hsgcmp->items(hqs.hcqr, state.numThreads);
 					hqs.flatenTime.end();
 				}
 				std::cout << "Hierarchical Spatial Grid Index query: " << state.str << std::endl;
@@ -729,16 +949,60 @@ int main(int argc, char const * argv[]) {
 					return -1;
 				}
 				hqs.cqrTime.begin();
-				hqs.hcqr = completers.shcmp->complete(state.str);
+				try {
+					hqs.hcqr = completers.shcmp->complete(state.str, state.numThreads, state.deadline(), state.maxLevel);
+				}
+				catch (hic::TimeoutException const & e) {
+					hqs.hcqr = sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR>();
+					reportTimeout(hqs.cqrTime, "Static Hierarchical Spatial Grid Index query", state.str, e);
+					break;
+				}
 				hqs.cqrTime.end();
 				if (state.numItems) {
 					hqs.flatenTime.begin();
-					hqs.items = hqs.hcqr->items();
+					hqs.items = completers.shcmp->items(hqs.hcqr, state.numThreads);
 					hqs.flatenTime.end();
 				}
 				std::cout << "Static Hierarchical Spatial Grid Index query: " << state.str << std::endl;
 				std::cout << hqs << std::endl;
 				
+			}
+				break;
+			case WorkItem::WI_SG_SERIALIZED_HCQR:
+			{
+				if (!completers.srcmp) {
+					std::cerr << "No serialized hcqr available" << std::endl;
+					return -1;
+				}
+				hic::Static::SerializedHcqrOpTree opTree(completers.srcmp);
+				opTree.deadline(state.deadline());
+				opTree.parse(state.str);
+				sqs.cqrTime.begin();
+				try {
+					sqs.hcqr = opTree.calc();
+				}
+				catch (hic::TimeoutException const & e) {
+					sqs.hcqr = hic::SerializedHcqr();
+					reportTimeout(sqs.cqrTime, "Serialized Hierarchical Spatial Grid Index query", state.str, e);
+					break;
+				}
+				sqs.cqrTime.end();
+				sqs.items = sserialize::ItemIndex();
+				//single strings are answered from the stored tree, hence the query is evaluated again
+				if (state.numItems) {
+					sqs.flatenTime.begin();
+					try {
+						sqs.items = opTree.items();
+					}
+					catch (hic::TimeoutException const & e) {
+						sqs.items = sserialize::ItemIndex();
+						reportTimeout(sqs.flatenTime, "Serialized Hierarchical Spatial Grid Index query", state.str, e);
+						break;
+					}
+					sqs.flatenTime.end();
+				}
+				std::cout << "Serialized Hierarchical Spatial Grid Index query: " << state.str << std::endl;
+				std::cout << sqs << std::endl;
 			}
 				break;
 			case WorkItem::WI_OSCAR_CQR:
@@ -767,11 +1031,18 @@ int main(int argc, char const * argv[]) {
 					return -1;
 				}
 				hqs.cqrTime.begin();
-				hqs.hcqr = completers.hocmp->complete(state.str);
+				try {
+					hqs.hcqr = completers.hocmp->complete(state.str, state.numThreads, state.deadline(), state.maxLevel);
+				}
+				catch (hic::TimeoutException const & e) {
+					hqs.hcqr = sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR>();
+					reportTimeout(hqs.cqrTime, "Hierarchical Oscar query", state.str, e);
+					break;
+				}
 				hqs.cqrTime.end();
 				if (state.numItems) {
 					hqs.flatenTime.begin();
-					hqs.items = hqs.hcqr->items();
+					hqs.items = completers.hocmp->items(hqs.hcqr, state.numThreads);
 					hqs.flatenTime.end();
 				}
 				std::cout << "Hierarchical Oscar query: " << state.str << std::endl;
@@ -815,5 +1086,29 @@ int main(int argc, char const * argv[]) {
 		}
 	}
 
+	if (!warmedUp) {
+		warmUp();
+	}
+
+	if (cfg.hcqrQueryLogFile.size()) {
+		//the queries of all completers, each one only once
+		std::vector<std::string> queries;
+		std::unordered_set<std::string> seen;
+		for(auto const & x : {completers.hocmp, completers.hsgcmp, completers.shcmp}) {
+			if (x) {
+				for(std::string const & str : x->queryLog()) {
+					if (seen.insert(str).second) {
+						queries.push_back(str);
+					}
+				}
+			}
+		}
+		try {
+			hic::HCQRCompleter::dumpQueryLog(cfg.hcqrQueryLogFile, queries);
+		}
+		catch (std::exception const & e) {
+			std::cerr << "Failed to write hcqr query log: " << e.what() << std::endl;
+		}
+	}
     return 0;
 }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sserialize/utility/exceptions.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace hic {
+
+///Thrown by query evaluations whose deadline expired or that were cancelled
+class TimeoutException: public sserialize::Exception {
+public:
+	TimeoutException(std::string const & msg) : sserialize::Exception("TimeoutException: " + msg) {}
+};
+
+///Deadline and cancellation token of a query evaluation.
+///Copies share their state, i.e. cancelling a copy cancels all evaluations using this deadline.
+class Deadline final {
+public:
+	using Clock = std::chrono::steady_clock;
+public:
+	///Expires only if cancelled
+	Deadline() : m_s(std::make_shared<State>()) {}
+	///Expires timeout after construction
+	Deadline(std::chrono::milliseconds timeout) : Deadline() {
+		m_s->deadline = Clock::now() + timeout;
+		m_s->timed = true;
+	}
+	~Deadline() {}
+public:
+	inline void cancel() { m_s->cancelled.store(true, std::memory_order_relaxed); }
+	inline bool cancelled() const { return m_s->cancelled.load(std::memory_order_relaxed); }
+	inline bool expired() const {
+		return cancelled() || (m_s->timed && Clock::now() >= m_s->deadline);
+	}
+	///Throws a TimeoutException if expired
+	inline void check(char const * where) const {
+		if (expired()) {
+			throw TimeoutException(std::string(where) + (cancelled() ? ": cancelled" : ": deadline expired"));
+		}
+	}
+private:
+	struct State {
+		std::atomic<bool> cancelled{false};
+		bool timed{false};
+		Clock::time_point deadline;
+	};
+private:
+	std::shared_ptr<State> m_s;
+};
+
+}//end namespace hic
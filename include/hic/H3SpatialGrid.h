@@ -28,6 +28,9 @@ public:
 public:
 	double area(PixelId pixel) const override;
 	sserialize::spatial::GeoRect bbox(PixelId pixel) const override;
+public:
+	///Pixels at the same level sharing an edge or a vertex with pixel
+	std::vector<PixelId> neighbours(PixelId pixel) const;
 protected:
 	H3SpatialGrid(uint32_t defaultLevel);
 	~H3SpatialGrid() override;
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <sserialize/spatial/dgg/HCQRIndex.h>
+#include <hic/HcqrOpTree.h>
+
+#include <mutex>
+#include <unordered_set>
+#include <string>
+#include <vector>
 
 namespace hic {
 	
@@ -8,13 +14,44 @@ class HCQRCompleter {
 public:
 	using HCQRIndex = sserialize::spatial::dgg::interface::HCQRIndex;
 	using HCQRIndexPtr = sserialize::RCPtrWrapper<HCQRIndex>;
+	using SpatialOpsPtr = HcqrOpTree::SpatialOps;
+	struct WarmUpStats {
+		std::size_t replayed{0};
+		///Queries using operations the index does not support
+		std::size_t unsupported{0};
+		///Queries that failed otherwise, each one with its error
+		std::vector<std::string> errors;
+	};
 public:
-	HCQRCompleter(HCQRIndexPtr const & index);
+	HCQRCompleter(HCQRIndexPtr const & index, SpatialOpsPtr const & spatialOps = SpatialOpsPtr());
 	~HCQRCompleter();
 public:
-	sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> complete(std::string const & str);
+	///Throws a hic::TimeoutException if deadline expires before the result is known.
+	///The result is not refined beyond maxLevel, see HcqrOpTree::maxLevel
+	sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> complete(std::string const & str, uint32_t threadCount = 1, hic::Deadline const & deadline = hic::Deadline(), uint32_t maxLevel = HcqrOpTree::NoMaxLevel);
+	///Items of a result of complete(), flattened in parallel if spatial operations are available
+	sserialize::ItemIndex items(sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> const & hcqr, uint32_t threadCount = 1) const;
+	///Item counts of a result of complete() per pixel at level, needs spatial operations
+	std::vector<hic::PixelCount> heatmap(sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> const & hcqr, uint32_t level) const;
+public:
+	///Record up to maxSize distinct query strings passed to complete(), 0 disables recording
+	void recordQueries(std::size_t maxSize);
+	///Recorded query strings in the order of their first occurrence
+	std::vector<std::string> queryLog() const;
+	///Writes queries to fileName, one per line, e.g. the merged query logs of several completers.
+	///Throws sserialize::IOException if the file cannot be written
+	static void dumpQueryLog(std::string const & fileName, std::vector<std::string> const & queries);
+	///Completes every query of the query log in fileName to fill the caches of the index, e.g. after a restart.
+	///Queries that fail are skipped and reported in the result.
+	///Throws sserialize::IOException if the file cannot be read
+	WarmUpStats warmUp(std::string const & fileName, uint32_t threadCount = 1);
 private:
 	HCQRIndexPtr m_d;
+	SpatialOpsPtr m_so;
+	mutable std::mutex m_queryLogLock;
+	std::size_t m_maxQueryLogSize{0};
+	std::vector<std::string> m_queryLog;
+	std::unordered_set<std::string> m_loggedQueries;
 };
 	
 }//end namespace hic
@@ -1,30 +1,138 @@
 #pragma once
 #include <sserialize/spatial/dgg/HCQR.h>
 #include <sserialize/spatial/dgg/HCQRIndex.h>
+#include <sserialize/spatial/dgg/SpatialGrid.h>
+#include <sserialize/spatial/GeoPoint.h>
+#include <sserialize/spatial/GeoRect.h>
 #include <liboscar/AdvancedOpTree.h>
 
+#include <limits>
+#include <unordered_map>
+
+#include <hic/ThreadBudget.h>
+#include <hic/Deadline.h>
+
+namespace hic {
+
+///Number of items of a result within a pixel of the spatial grid.
+///Items spanning multiple cells are counted once per cell
+struct PixelCount {
+	sserialize::spatial::dgg::interface::SpatialGrid::PixelId pixelId;
+	uint32_t itemCount;
+};
+
+} //end namespace hic
+
+namespace hic::interface {
+
+///Spatial operations of a search index that go beyond the HCQRIndex interface.
+///Returned HCQRs have to be compatible with the ones of the corresponding HCQRIndex
+class HcqrSpatialOps: public sserialize::RefCountObject {
+public:
+    using HCQRPtr = sserialize::spatial::dgg::interface::HCQR::HCQRPtr;
+public:
+	HcqrSpatialOps() {}
+	virtual ~HcqrSpatialOps() {}
+public:
+	virtual HCQRPtr polygon(std::vector<sserialize::spatial::GeoPoint> const & points) const = 0;
+	virtual HCQRPtr path(double radius, std::vector<sserialize::spatial::GeoPoint> const & points) const = 0;
+	///Everything within distance meters of hcqr as full-match, hcqr itself is only part of the result if withSource is true
+	virtual HCQRPtr near(HCQRPtr const & hcqr, double distance, bool withSource) const = 0;
+	virtual HCQRPtr item(uint32_t itemId) const = 0;
+	///Cells of the most relevant item of hcqr as full-match
+	virtual HCQRPtr relevantElement(HCQRPtr const & hcqr) const = 0;
+	///Union of the cells covered by the regions in hcqr
+	virtual HCQRPtr in(HCQRPtr const & hcqr) const = 0;
+	///One HCQR per child of the root pixel of the spatial grid with a single full-match node at that child.
+	///They are pairwise disjoint and cover the whole grid.
+	virtual std::vector<HCQRPtr> const & rootRegions() const = 0;
+	///Cells inside rect as full-match, cells intersecting its boundary as partial-match with all their items
+	virtual HCQRPtr rect(sserialize::spatial::GeoRect const & rect) const = 0;
+	///The given cells as full-match, invalid cell ids are skipped
+	virtual HCQRPtr cells(std::vector<uint32_t> const & cellIds) const = 0;
+	///Cells of the region that are not covered by any of its child regions
+	virtual HCQRPtr regionExclusiveCells(uint32_t regionId) const = 0;
+	///Item counts of hcqr aggregated at the pixels of the given level in ascending order of their pixel id.
+	///Computed from the sizes of the cells of full-match nodes and the index sizes of partial-match nodes,
+	///partial-match nodes above level are counted at their own pixel
+	virtual std::vector<hic::PixelCount> heatmap(HCQRPtr const & hcqr, uint32_t level) const = 0;
+};
+
+} //end namespace hic::interface
+
 namespace hic {
 
 class HcqrOpTree: public liboscar::AdvancedOpTree {
 public:
     using SearchIndex = sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQRIndex>;
     using HCQRPtr = sserialize::spatial::dgg::interface::HCQR::HCQRPtr;
+	using SpatialOps = sserialize::RCPtrWrapper<hic::interface::HcqrSpatialOps>;
+public:
+	///Minimum leaf cost of both operands of a set operation to evaluate them in parallel, see leafCost().
+	///Two string leaves are hence evaluated in parallel
+	static constexpr std::size_t ParallelLeafCostThreshold = 1;
+	///Minimum number of HCQR nodes of an operand to split set operations and flattening by root subtrees
+	static constexpr std::size_t ParallelHcqrNodeThreshold = 1024;
+	///Results are built down to the level of the cells
+	static constexpr uint32_t NoMaxLevel = std::numeric_limits<uint32_t>::max();
 public:
-    HcqrOpTree(SearchIndex const & si);
+	///Spatial leaves like polygons are only supported if so is set
+    HcqrOpTree(SearchIndex const & si, SpatialOps const & so = SpatialOps());
     virtual ~HcqrOpTree();
 public:
-    HCQRPtr calc();
+	///Operands of set operations are evaluated in parallel if threadCount > 1
+    HCQRPtr calc(uint32_t threadCount = 1);
+	///Evaluation throws a hic::TimeoutException once deadline expired.
+	///It is checked before evaluating a subtree and before applying a set operation.
+	void deadline(hic::Deadline const & deadline) { m_deadline = deadline; }
+	///Level of detail of the evaluation, e.g. for rendering zoomed-out maps.
+	///The results of leaves and unary operations are collapsed to maxLevel before any set operation is applied,
+	///i.e. nodes below maxLevel become partial-match nodes at maxLevel holding the items of their subtree.
+	///Set operations then never descend below maxLevel and compare items per pixel at maxLevel.
+	///An item spanning several cells of such a pixel may hence match although no single cell matches.
+	///The HCQRIndex interface cannot build the results of leaves only down to a level, so leaves are still fetched completely.
+	///Coarse item counts without a result tree are available via heatmap().
+	void maxLevel(uint32_t maxLevel) { m_maxLevel = maxLevel; }
+public:
+	///Items of hcqr. If so is set and hcqr is large, the subtrees of the roots of the grid are flattened by threadCount threads
+	static sserialize::ItemIndex items(HCQRPtr const & hcqr, SpatialOps const & so, uint32_t threadCount);
+	///Set operation op of a and b where a missing operand is an empty result
+	static HCQRPtr apply(char op, HCQRPtr const & a, HCQRPtr const & b);
+	///Item counts of hcqr per pixel at level, see HcqrSpatialOps::heatmap
+	static std::vector<hic::PixelCount> heatmap(HCQRPtr const & hcqr, SpatialOps const & so, uint32_t level);
 private:
     class Calc final {
     public:
-        Calc(SearchIndex const & d) : m_d(d) {}
+        ///The leaf costs of the subtrees of root are computed once up front
+        Calc(SearchIndex const & d, SpatialOps const & so, uint32_t threadCount, hic::Deadline const & deadline, uint32_t maxLevel, const Node * root) :
+        m_d(d), m_so(so), m_tb(threadCount), m_deadline(deadline), m_maxLevel(maxLevel) { cost(root); }
         ~Calc() {}
+		///Result of node collapsed to the level of detail
         HCQRPtr calc(const Node * node);
+    private:
+		HCQRPtr calcNode(const Node * node);
+		///Applies op to the parts of a and b in each root subtree of the grid in parallel, see HcqrSpatialOps::rootRegions
+		HCQRPtr fanOut(char op, HCQRPtr const & a, HCQRPtr const & b);
+		///Unites results pairwise, possibly in parallel
+		HCQRPtr unite(std::vector<HCQRPtr> results);
+		///Estimated cost of the leaves of a subtree: 1 for leaves that fetch or cover data, 0 for single cells and items
+		static std::size_t leafCost(const Node * node);
+		///Fills m_cost for the subtree of node
+		std::size_t cost(const Node * node);
     private:
         SearchIndex m_d;
+		SpatialOps m_so;
+		hic::detail::ThreadBudget m_tb;
+		hic::Deadline m_deadline;
+		uint32_t m_maxLevel;
+		///Leaf cost of each subtree, only read during the evaluation
+		std::unordered_map<const Node*, std::size_t> m_cost;
     };
 private:
     SearchIndex m_d;
+	SpatialOps m_so;
+	hic::Deadline m_deadline;
+	uint32_t m_maxLevel{NoMaxLevel};
 };
 
 } //end namespace hic
@@ -42,11 +42,14 @@ public:
 		std::vector<HtmIndexId> m_trixelId2HtmIndex;
 	};
 	enum FlusherType { FT_IN_MEMORY, FT_NO_OP};
+	///Optional parts of the serialized index
+	enum CreationFlags { CF_NONE=0x0, CF_ITEM_TRIXELS=0x1, CF_REGION_EXCLUSIVE_TRIXELS=0x2 };
 public:
 	OscarSearchSgIndex(std::shared_ptr<Completer> cmp, std::shared_ptr<OscarSgIndex> ohi);
 public:
 	void create(uint32_t threadCount, FlusherType ft = FT_IN_MEMORY);
-	sserialize::UByteArrayAdapter & create(sserialize::UByteArrayAdapter & dest, uint32_t threadCount);
+	///flags is a combination of CreationFlags
+	sserialize::UByteArrayAdapter & create(sserialize::UByteArrayAdapter & dest, uint32_t threadCount, int flags = CF_NONE);
 public:
 	sserialize::UByteArrayAdapter & serialize(sserialize::UByteArrayAdapter & dest) const;
 public:
@@ -59,7 +62,8 @@ public:
 	TrieType trie() const;
 	CellTextCompleter ctc() const;
 private:
-	enum ItemMatchType {IM_NONE=0x0, IM_ITEMS=0x1, IM_REGIONS=0x2};
+	///IM_REGION_CELLS and IM_REGION_EXCLUSIVE_CELLS process the (exclusive) cells of GeoHierarchy regions instead of strings
+	enum ItemMatchType {IM_NONE=0x0, IM_ITEMS=0x1, IM_REGIONS=0x2, IM_REGION_CELLS=0x4, IM_REGION_EXCLUSIVE_CELLS=0x8};
 	
 	struct State {
 		std::atomic<uint32_t> strId{0};
@@ -163,6 +167,8 @@ private:
 	};
 private:
 	void computeTrixelItems();
+	///item id -> sorted trixel ids as two BoundedCompactUintArrays: begin offsets (itemCount+1) and trixel ids
+	void serializeItemTrixels(sserialize::UByteArrayAdapter & dest) const;
 private:
 	std::shared_ptr<Completer> m_cmp;
 	std::shared_ptr<OscarSgIndex> m_ohi;
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <sserialize/storage/UByteArrayAdapter.h>
+#include <sserialize/containers/ItemIndex.h>
+#include <sserialize/Static/ItemIndexStore.h>
+#include <sserialize/spatial/CellQueryResult.h>
+#include <sserialize/spatial/dgg/SpatialGrid.h>
+#include <sserialize/spatial/dgg/Static/SpatialGridInfo.h>
+
+#include <hic/SpatialGridCells.h>
+#include <hic/SpatialGridCovering.h>
+
+#include <memory>
+
+namespace hic {
+
+/**
+ * Hierarchical cell query result stored as a pre-order serialized tree of grid pixels.
+ * Set operations merge two serialized trees node by node and write the result directly into a single buffer,
+ * subtrees present in only one operand are copied as raw bytes. No pointer tree is ever built.
+ * The header of an internal node is written before its children and filled in once they are done,
+ * hence every byte of the result is written once.
+ * Children are located by the child table of their parent, hence subtrees that a set operation
+ * skips or copies are never decoded, i.e. subtrees it skips are never paged in if data is mmapped.
+ * Full-match nodes above the cell level, e.g. from fromCovering(), let an intersection copy the whole
+ * subtree of the other operand by its table entry.
+ *
+ *  struct Node {
+ *      vu64 pixelId;
+ *      uint<8> type; //NodeType
+ *      if (type == NT_INTERNAL) {
+ *          uint<32> childCount;
+ *          uint<64> childrenSize; //in bytes
+ *          uint<32> childTableSize; //in bytes
+ *          Node children[childCount]; //ascending by pixelId
+ *          struct {
+ *              vu64 pixelId;
+ *              vu64 size; //in bytes
+ *          } childTable[childCount];
+ *      }
+ *      else if (type == NT_PARTIAL_MATCH) {
+ *          vu32 itemCount;
+ *          vu64 itemsSize; //in bytes
+ *          vu32 itemIdDeltas[itemCount];
+ *      }
+ *  };
+ *
+ * The sizes of internal nodes have a fixed width since they are only known after the children were written.
+ * An empty result has no nodes at all.
+ * Partial-match nodes are leaves at the level of the cells of the index.
+ * Full-match nodes may be at any level and contain all items of the cells below them.
+ *
+ * SerializedHcqrTextIndex stores these trees as payloads, SerializedHcqrOpTree evaluates queries on them.
+ */
+class SerializedHcqr final {
+public:
+	using SpatialGrid = sserialize::spatial::dgg::interface::SpatialGrid;
+	using PixelId = SpatialGrid::PixelId;
+	using SpatialGridInfo = sserialize::spatial::dgg::Static::SpatialGridInfo;
+	using SizeType = sserialize::UByteArrayAdapter::SizeType;
+	enum NodeType : uint8_t { NT_INTERNAL=0, NT_FULL_MATCH=1, NT_PARTIAL_MATCH=2 };
+	///Grid, cells and items of the cells, shared by all results of an index
+	struct Context {
+		sserialize::RCPtrWrapper<SpatialGrid> sg;
+		std::shared_ptr<SpatialGridInfo> sgInfo;
+		sserialize::Static::ItemIndexStore idxStore;
+		///Cells below full-match nodes
+		std::shared_ptr<SpatialGridCells const> cells;
+	};
+	using ContextPtr = std::shared_ptr<Context const>;
+public:
+	SerializedHcqr();
+	SerializedHcqr(sserialize::UByteArrayAdapter const & data, ContextPtr const & ctx);
+	~SerializedHcqr();
+	///cqr has to use the compressed cell ids of ctx->sgInfo
+	static SerializedHcqr fromCqr(sserialize::CellQueryResult const & cqr, ContextPtr const & ctx);
+	///Interior pixels become full-match nodes at their own level, boundary pixels partial-match nodes with all items of their cell.
+	///Pixels without cells below them are skipped
+	static SerializedHcqr fromCovering(SpatialGridCovering const & covering, ContextPtr const & ctx);
+public:
+	SerializedHcqr operator+(SerializedHcqr const & other) const;
+	SerializedHcqr operator/(SerializedHcqr const & other) const;
+	SerializedHcqr operator-(SerializedHcqr const & other) const;
+public:
+	inline bool empty() const { return !m_d.size(); }
+	inline sserialize::UByteArrayAdapter const & data() const { return m_d; }
+	inline ContextPtr const & context() const { return m_ctx; }
+	std::size_t numberOfNodes() const;
+	sserialize::ItemIndex items() const;
+private:
+	friend class SuccinctHcqr;
+private:
+	struct Node {
+		PixelId pixelId;
+		NodeType type;
+		uint32_t count{0};
+		///offset of the node, its child table or items and the end of the node in data
+		SizeType begin;
+		SizeType payloadBegin;
+		SizeType end;
+		///offset of the first child of internal nodes, the child table starts at payloadBegin
+		SizeType childrenBegin;
+	};
+	///Entry of the child table of an internal node
+	struct ChildRef {
+		PixelId pixelId;
+		SizeType begin;
+		SizeType end;
+	};
+	///Leaf of a tree built by fromLeaves()
+	struct Leaf {
+		PixelId pixelId;
+		NodeType type;
+		///Items of partial-match leaves
+		std::vector<uint32_t> items;
+	};
+	struct Union;
+	struct Intersection;
+	struct Difference;
+	class Merger;
+private:
+	///Tree containing the given pairwise disjoint leaves
+	static SerializedHcqr fromLeaves(std::vector<Leaf> leaves, ContextPtr const & ctx);
+	static Node node(sserialize::UByteArrayAdapter const & data, SizeType offset);
+	static std::vector<uint32_t> partialItems(sserialize::UByteArrayAdapter const & data, Node const & node);
+	///Children of an internal node without reading them
+	static std::vector<ChildRef> children(sserialize::UByteArrayAdapter const & data, Node const & node);
+	static void putFull(PixelId pixelId, sserialize::UByteArrayAdapter & dest);
+	///Nothing is written if items is empty
+	static void putPartial(PixelId pixelId, std::vector<uint32_t> const & items, sserialize::UByteArrayAdapter & dest);
+	///Writes the header of an internal node and returns its offset in dest, its children have to be appended directly after it
+	static SizeType beginInternal(PixelId pixelId, sserialize::UByteArrayAdapter & dest);
+	///Appends the child table of the internal node at begin and fills in its header.
+	///children are the offsets of the children in dest. The node is removed again if there are none
+	static void endInternal(SizeType begin, std::vector<ChildRef> const & children, sserialize::UByteArrayAdapter & dest);
+	///Items of all cells below pixel
+	sserialize::ItemIndex cellItems(PixelId pixel) const;
+private:
+	sserialize::UByteArrayAdapter m_d;
+	ContextPtr m_ctx;
+};
+
+}//end namespace hic
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sserialize/Static/Array.h>
+
+#include <liboscar/AdvancedOpTree.h>
+
+#include <hic/SerializedHcqr.h>
+#include <hic/static-htm-index.h>
+#include <hic/Deadline.h>
+
+namespace hic::Static {
+
+/**
+ * Text index with SerializedHcqr or SuccinctHcqr trees as payloads, see OscarSearchHCQRTextIndexCreator::treeFormat.
+ * Set operations need the pre-order encoding. Only SerializedHcqr payloads are accessed lazily,
+ * i.e. subtrees a set operation skips are never decoded or paged in.
+ * SuccinctHcqr payloads are always decoded in full by complete(), they trade query time for space.
+ * items() works on the stored trees directly in both formats.
+ * Trie, grid and cells are the ones of the OscarSearchSgIndex the trees were created from.
+ *
+ *  struct SerializedHcqrTextIndex: Version(2) {
+ *      uint<8> treeFormat; //OscarSearchHCQRTextIndexCreator::TreeFormat
+ *      sserialize::Static::Array<Payload> mixed;
+ *      sserialize::Static::Array<Payload> items;
+ *      sserialize::Static::Array<Payload> regions;
+ *  };
+ *
+ *  struct Payload {
+ *      uint<8> types; //sserialize::StringCompleter::QuerryType
+ *      struct {
+ *          vu32 header; //size << 1 of a tree, 1 for a reference
+ *          if (header & 1) { //same tree as the one stored in another payload, which is never a reference itself
+ *              uint<8> source; //OscarSearchSgIndex::PayloadSource
+ *              vu32 position;
+ *              uint<8> queryType;
+ *          }
+ *          else {
+ *              uint<8> tree[header >> 1]; //SerializedHcqr or SuccinctHcqr depending on treeFormat
+ *          }
+ *      } trees[popcount(types)]; //exact, prefix, suffix, substring
+ *  };
+ *
+ * Payloads are at the trie position of their string in the source index.
+ * Trees with the same cells and items are stored once if OscarSearchHCQRTextIndexCreator::payloadCacheBytes is set.
+ **/
+
+class SerializedHcqrTextIndex: public sserialize::RefCountObject {
+public:
+	using Self = SerializedHcqrTextIndex;
+	using PayloadSource = OscarSearchSgIndex::PayloadSource;
+	using TreeFormat = OscarSearchHCQRTextIndexCreator::TreeFormat;
+public:
+	struct MetaData {
+		static constexpr uint8_t version{2};
+	};
+public:
+	///base is the index the trees were created from
+	static sserialize::RCPtrWrapper<Self> make(sserialize::UByteArrayAdapter const & d, sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base);
+	///Context of trees built from results of index
+	static SerializedHcqr::ContextPtr makeContext(OscarSearchSgIndex const & index);
+	virtual ~SerializedHcqrTextIndex() override;
+public:
+	///Tree of the string query, empty if there is none. Succinct trees are decoded in full
+	SerializedHcqr complete(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source = OscarSearchSgIndex::PS_MIXED) const;
+	///Items of the string query without converting its tree
+	sserialize::ItemIndex items(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source = OscarSearchSgIndex::PS_MIXED) const;
+	///Tree of a result of the base index
+	SerializedHcqr fromCqr(sserialize::CellQueryResult const & cqr) const;
+	///Tree of a covering of the grid of the base index, see SerializedHcqr::fromCovering
+	SerializedHcqr fromCovering(SpatialGridCovering const & covering) const;
+	SerializedHcqr empty() const;
+public:
+	inline OscarSearchSgIndex const & base() const { return *m_base; }
+	inline SerializedHcqr::ContextPtr const & context() const { return m_ctx; }
+	inline TreeFormat treeFormat() const { return m_treeFormat; }
+private:
+	SerializedHcqrTextIndex(sserialize::UByteArrayAdapter const & d, sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base);
+	sserialize::Static::Array<sserialize::UByteArrayAdapter> const & payloads(PayloadSource source) const;
+	///Stored tree of the string query in treeFormat(), empty if there is none
+	sserialize::UByteArrayAdapter tree(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source) const;
+	///Tree of type qt in payload, references are resolved
+	sserialize::UByteArrayAdapter tree(sserialize::UByteArrayAdapter const & payload, sserialize::StringCompleter::QuerryType qt) const;
+private:
+	sserialize::RCPtrWrapper<OscarSearchSgIndex> m_base;
+	SerializedHcqr::ContextPtr m_ctx;
+	TreeFormat m_treeFormat;
+	sserialize::Static::Array<sserialize::UByteArrayAdapter> m_mixed;
+	sserialize::Static::Array<sserialize::UByteArrayAdapter> m_items;
+	sserialize::Static::Array<sserialize::UByteArrayAdapter> m_regions;
+};
+
+///Evaluates queries on a SerializedHcqrTextIndex.
+///Supports string, region, cell, rectangle, polygon, path and item leaves and set operations.
+///Rectangles, polygons and paths are built from their covering with full-match nodes above the cell level,
+///hence intersecting them with a stored tree copies or skips whole subtrees of it by their child table entries.
+///Other spatial leaves are resolved by the base index and converted with SerializedHcqr::fromCqr
+class SerializedHcqrOpTree: public liboscar::AdvancedOpTree {
+public:
+	SerializedHcqrOpTree(sserialize::RCPtrWrapper<SerializedHcqrTextIndex> const & d);
+	virtual ~SerializedHcqrOpTree();
+public:
+	///Evaluation throws a hic::TimeoutException once deadline expired
+	void deadline(hic::Deadline const & deadline) { m_deadline = deadline; }
+	SerializedHcqr calc();
+	///Items of the query, a single string is answered by SerializedHcqrTextIndex::items()
+	sserialize::ItemIndex items();
+private:
+	SerializedHcqr calc(const Node * node);
+private:
+	sserialize::RCPtrWrapper<SerializedHcqrTextIndex> m_d;
+	hic::Deadline m_deadline;
+};
+
+}//end namespace hic::Static
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <sserialize/spatial/dgg/SpatialGrid.h>
+#include <sserialize/spatial/dgg/Static/SpatialGridInfo.h>
+
+#include <memory>
+#include <vector>
+
+namespace hic {
+
+///The cells of an index and all their ancestor pixels in the spatial grid.
+///Cells below a pixel are found by descending only into children that contain cells,
+///hence the cost depends on the number of cells found and not on the size of the grid below the pixel.
+class SpatialGridCells final {
+public:
+	using SpatialGrid = sserialize::spatial::dgg::interface::SpatialGrid;
+	using SpatialGridInfo = sserialize::spatial::dgg::Static::SpatialGridInfo;
+	using PixelId = SpatialGrid::PixelId;
+public:
+	///Walks the parents of every cell of sgInfo once
+	SpatialGridCells(sserialize::RCPtrWrapper<SpatialGrid> const & sg, std::shared_ptr<SpatialGridInfo> const & sgInfo);
+	~SpatialGridCells();
+public:
+	///True if pixel is a cell or an ancestor of a cell
+	bool contains(PixelId pixel) const;
+	///Children of pixel that are cells or ancestors of cells in ascending order
+	std::vector<PixelId> children(PixelId pixel) const;
+	///Appends the compressed ids of all cells at or below pixel to dest in no particular order
+	void cellIds(PixelId pixel, std::vector<uint32_t> & dest) const;
+private:
+	sserialize::RCPtrWrapper<SpatialGrid> m_sg;
+	std::shared_ptr<SpatialGridInfo> m_sgInfo;
+	///Sorted pixel ids of all ancestors of cells
+	std::vector<PixelId> m_ancestors;
+};
+
+}//end namespace hic
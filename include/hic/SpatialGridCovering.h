@@ -0,0 +1,92 @@
+#pragma once
+
+#include <sserialize/spatial/dgg/SpatialGrid.h>
+#include <sserialize/spatial/GeoRect.h>
+#include <sserialize/spatial/GeoPoint.h>
+
+#include <functional>
+
+namespace hic {
+
+///Pixels of a spatial grid covering a region
+struct SpatialGridCovering {
+	using PixelId = sserialize::spatial::dgg::interface::SpatialGrid::PixelId;
+	///pixels completely inside the region, at or above the level of the covering.
+	///A pixel above the level stands for all its descendants at the level, see OscarSearchSgIndex::cellIds()
+	std::vector<PixelId> interior;
+	///pixels at the level of the covering intersecting the boundary of the region
+	std::vector<PixelId> boundary;
+};
+
+///Computes pixel coverings by descending the grid hierarchy and pruning pixels by their bounding box.
+///Works with every spatial grid implementing bbox(), childrenCount() and index(parent, childNumber).
+///
+///Relations are computed in the plane of latitude and longitude:
+///polygon and path edges are straight lines in lat/lon and not great circles,
+///distances use an equirectangular projection with a fixed number of meters per degree of latitude.
+///Both are accurate for regions spanning a few degrees and degrade for large regions and near the poles.
+///Regions crossing the antimeridian are not supported: a GeoRect always spans from minLon to maxLon
+///and polygons or paths with an edge spanning more than 180 degrees of longitude are rejected.
+///Such regions have to be split at the antimeridian and queried as the union of their parts.
+class SpatialGridCoverer {
+public:
+	using SpatialGrid = sserialize::spatial::dgg::interface::SpatialGrid;
+	using PixelId = SpatialGrid::PixelId;
+	using Level = SpatialGrid::Level;
+	using GeoPoint = sserialize::spatial::GeoPoint;
+	enum Relation { R_DISJOINT, R_INTERSECTS, R_CONTAINED };
+	///Returns the relation of the region to a pixel given its bounding box
+	using RelationFunction = std::function<Relation(sserialize::spatial::GeoRect const &)>;
+public:
+	SpatialGridCoverer(SpatialGrid const & sg);
+	~SpatialGridCoverer();
+public:
+	SpatialGridCovering cover(sserialize::spatial::GeoRect const & rect, Level level) const;
+	SpatialGridCovering cover(sserialize::spatial::GeoRect const & rect) const;
+	///Closed polygon given by its vertices, the last vertex is connected to the first one.
+	///Throws sserialize::UnsupportedFeatureException if an edge crosses the antimeridian
+	SpatialGridCovering polygon(std::vector<GeoPoint> const & points, Level level) const;
+	///All points within radius meters of the polyline given by points.
+	///Throws sserialize::UnsupportedFeatureException if a segment crosses the antimeridian
+	SpatialGridCovering path(double radius, std::vector<GeoPoint> const & points, Level level) const;
+	///Covering of an arbitrary region given by its relation to bounding boxes
+	SpatialGridCovering cover(RelationFunction const & rel, Level level) const;
+public:
+	///Pixels at the same level sharing an edge or a vertex with pixel.
+	///Uses the native neighbourhood of htm, h3 and s2 grids and samples around the bounding box otherwise
+	std::vector<PixelId> neighbours(PixelId pixel) const;
+	///pixels and all pixels reachable with at most rounds neighbour steps. The result is sorted
+	std::vector<PixelId> dilate(std::vector<PixelId> const & pixels, uint32_t rounds) const;
+	///Number of neighbour steps needed to reach everything within distance meters of pixel.
+	///Each step is assumed to cover MinWidthFactor*sqrt(area(pixel)), a lower bound of the width of the pixel
+	uint32_t rounds(PixelId pixel, double distance) const;
+	///Number of neighbour steps needed to reach everything within distance meters of each of pixels
+	uint32_t rounds(std::vector<PixelId> const & pixels, double distance) const;
+	///Lower bound of the width of a pixel relative to the square root of its area.
+	///Equilateral triangles have 0.88, squares 1 and hexagons 1.07, 0.5 also holds for pixels distorted by up to a factor of 4
+	static constexpr double MinWidthFactor = 0.5;
+public:
+	static Relation relation(sserialize::spatial::GeoRect const & region, sserialize::spatial::GeoRect const & pixel);
+	static Relation polygonRelation(std::vector<GeoPoint> const & points, sserialize::spatial::GeoRect const & pixel);
+	static Relation pathRelation(double radius, std::vector<GeoPoint> const & points, sserialize::spatial::GeoRect const & pixel);
+	///Approximate distance in meters of p to the closest point of rect
+	static double distance(GeoPoint const & p, sserialize::spatial::GeoRect const & rect);
+public:
+	///Parses a polygon given as a list of lat, lon pairs
+	static std::vector<GeoPoint> parsePolygon(std::string const & str);
+	///Parses a path given as radius followed by a list of lat, lon pairs
+	static std::pair<double, std::vector<GeoPoint>> parsePath(std::string const & str);
+	///Parses the cell ids of a cells query, i.e. all unsigned numbers of str
+	static std::vector<uint32_t> parseCellIds(std::string const & str);
+private:
+	void cover(PixelId pixel, Level level, RelationFunction const & rel, SpatialGridCovering & dest) const;
+	///Box containing all descendants of pixel at level.
+	///This is the bounding box of pixel if the bounding boxes of its children lie within it (htm, s2).
+	///Otherwise children extend beyond the boundary of their parent (h3) and the box is derived from the children,
+	///see the implementation for the bound on deeper descendants.
+	sserialize::spatial::GeoRect pruneBox(PixelId pixel, Level level) const;
+private:
+	SpatialGrid const & m_sg;
+};
+
+}//end namespace hic
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <hic/SerializedHcqr.h>
+#include <sserialize/containers/CompactUintArray.h>
+
+#include <limits>
+
+namespace hic {
+
+/**
+ * Succinct encoding of a SerializedHcqr.
+ * The tree shape is a LOUDS bit vector, the node payloads are stored in parallel arrays in level order.
+ * Pixel ids are not stored, they are derived from the position of each node within its parent.
+ *
+ *  struct SuccinctHcqr {
+ *      vu32 nodeCount;
+ *      vu32 wordCount;
+ *      uint<64> louds[wordCount]; //"10" followed by 1^childCount 0 for every node in level order
+ *      sserialize::BoundedCompactUintArray onesBefore; //number of ones before each word
+ *      sserialize::BoundedCompactUintArray zeroSamples; //word of every SelectSampleRate-th zero
+ *      sserialize::BoundedCompactUintArray childPositions; //child number of each node within its parent
+ *      sserialize::BoundedCompactUintArray types; //SerializedHcqr::NodeType of each node
+ *      sserialize::BoundedCompactUintArray itemsBegin; //nodeCount+1 entries, only partial-match nodes have items
+ *      sserialize::BoundedCompactUintArray items;
+ *  };
+ *
+ * An empty result has no bytes at all.
+ * Locating the children of a node needs a select on the zeros of the LOUDS. It starts at the word of the preceding
+ * zero sample and scans forward. Every node adds at most f ones and one zero, f being the fan-out of its pixel,
+ * hence at most SelectSampleRate*(1+f)/64+1 words are read. With SelectSampleRate=8 this is 2 words for grids
+ * with a fan-out of up to 7 like HTM, S2 and H3 below their root. Only the samples next to the root of H3 with its
+ * 122 children span more words.
+ *
+ * SerializedHcqrTextIndex stores these as payloads if created with OscarSearchHCQRTextIndexCreator::TF_SUCCINCT_HCQR.
+ */
+class SuccinctHcqr final {
+public:
+	using PixelId = SerializedHcqr::PixelId;
+	using NodeType = SerializedHcqr::NodeType;
+	using ContextPtr = SerializedHcqr::ContextPtr;
+	using SizeType = sserialize::UByteArrayAdapter::SizeType;
+	static constexpr uint32_t SelectSampleRate = 8;
+	class Node final {
+	public:
+		Node() {}
+		inline bool valid() const { return m_id != Invalid; }
+		inline uint32_t id() const { return m_id; }
+		inline PixelId pixelId() const { return m_pixelId; }
+	private:
+		friend class SuccinctHcqr;
+		static constexpr uint32_t Invalid = std::numeric_limits<uint32_t>::max();
+		Node(uint32_t id, PixelId pixelId) : m_id(id), m_pixelId(pixelId) {}
+	private:
+		uint32_t m_id{Invalid};
+		PixelId m_pixelId{0};
+	};
+public:
+	SuccinctHcqr();
+	SuccinctHcqr(sserialize::UByteArrayAdapter const & data, ContextPtr const & ctx);
+	~SuccinctHcqr();
+	static SuccinctHcqr fromSerialized(SerializedHcqr const & hcqr);
+	///Set operations are done on the pre-order encoding
+	SerializedHcqr toSerialized() const;
+public:
+	inline bool empty() const { return !m_nodeCount; }
+	inline sserialize::UByteArrayAdapter const & data() const { return m_d; }
+	inline std::size_t numberOfNodes() const { return m_nodeCount; }
+	///Items of full-match nodes are taken from the cells of the context, nothing is converted to the pre-order encoding
+	sserialize::ItemIndex items() const;
+public:
+	///Invalid node if empty
+	Node root() const;
+	uint32_t childCount(Node const & node) const;
+	Node child(Node const & node, uint32_t i) const;
+	NodeType type(Node const & node) const;
+	///Items of a partial-match node
+	std::vector<uint32_t> items(Node const & node) const;
+private:
+	uint64_t word(uint32_t i) const;
+	///Number of ones before bit pos
+	uint32_t rank1(uint64_t pos) const;
+	///Position of the j-th zero, j > 0
+	uint64_t select0(uint32_t j) const;
+	///Position of the first child of node id in the LOUDS
+	inline uint64_t childrenBegin(uint32_t id) const { return select0(id+1)+1; }
+	void serialize(Node const & node, sserialize::UByteArrayAdapter & dest) const;
+private:
+	sserialize::UByteArrayAdapter m_d;
+	ContextPtr m_ctx;
+	uint32_t m_nodeCount{0};
+	uint32_t m_wordCount{0};
+	sserialize::UByteArrayAdapter m_louds;
+	sserialize::BoundedCompactUintArray m_onesBefore;
+	sserialize::BoundedCompactUintArray m_zeroSamples;
+	sserialize::BoundedCompactUintArray m_childPositions;
+	sserialize::BoundedCompactUintArray m_types;
+	sserialize::BoundedCompactUintArray m_itemsBegin;
+	sserialize::BoundedCompactUintArray m_items;
+};
+
+}//end namespace hic
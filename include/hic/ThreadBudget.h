@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hic::detail {
+
+///Fixed set of worker threads shared by all computations of the process, started on first use
+class WorkerPool final {
+public:
+	WorkerPool(uint32_t threadCount) {
+		for(uint32_t i(0); i < threadCount; ++i) {
+			m_workers.emplace_back([this]() { run(); });
+		}
+	}
+	WorkerPool(WorkerPool const &) = delete;
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lck(m_lock);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		for(std::thread & x : m_workers) {
+			x.join();
+		}
+	}
+public:
+	///One worker per hardware thread
+	static WorkerPool & instance() {
+		static WorkerPool pool(std::max<uint32_t>(1, std::thread::hardware_concurrency()));
+		return pool;
+	}
+	void push(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lck(m_lock);
+			m_tasks.emplace_back(std::move(task));
+		}
+		m_cv.notify_one();
+	}
+private:
+	void run() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lck(m_lock);
+				m_cv.wait(lck, [this]() { return m_stop || m_tasks.size(); });
+				if (!m_tasks.size()) {
+					return;
+				}
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+private:
+	std::mutex m_lock;
+	std::condition_variable m_cv;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stop{false};
+	std::vector<std::thread> m_workers;
+};
+
+///Hands out a fixed number of additional threads to recursive computations.
+///Tasks that get a thread are run by the WorkerPool, hence no thread is created per task.
+///Tasks are run by the thread requesting their result if they were not handed to the pool or no worker started them yet.
+///This way nested tasks never wait on tasks that are not running, even if all workers are busy.
+class ThreadBudget final {
+private:
+	template<typename T>
+	struct Task {
+		std::function<T()> fn;
+		std::atomic<bool> claimed{false};
+		std::promise<T> promise;
+		std::future<T> result{promise.get_future()};
+		Task(std::function<T()> fn) : fn(std::move(fn)) {}
+		///Only the first caller runs the task
+		bool claim() { return !claimed.exchange(true, std::memory_order_acq_rel); }
+		void run() {
+			try {
+				promise.set_value(fn());
+			}
+			catch (...) {
+				promise.set_exception(std::current_exception());
+			}
+		}
+	};
+public:
+	///Result of a task passed to async()
+	template<typename T>
+	class Future final {
+	public:
+		Future(std::shared_ptr<Task<T>> const & task) : m_task(task) {}
+		Future(Future &&) = default;
+		Future & operator=(Future &&) = default;
+		///Drops the task if it did not start yet, waits for it otherwise since it may reference the state of the caller
+		~Future() {
+			if (m_task && !m_task->claim()) {
+				m_task->result.wait();
+			}
+		}
+		///Runs the task in the calling thread if no worker started it yet
+		T get() {
+			std::shared_ptr<Task<T>> task = std::move(m_task);
+			if (task->claim()) {
+				task->run();
+			}
+			return task->result.get();
+		}
+	private:
+		std::shared_ptr<Task<T>> m_task;
+	};
+public:
+	ThreadBudget(uint32_t threadCount) : m_free(std::make_shared<std::atomic<int32_t>>(threadCount > 1 ? threadCount-1 : 0)) {}
+	ThreadBudget(ThreadBudget const &) = delete;
+	~ThreadBudget() {}
+public:
+	inline bool parallel() const { return m_free->load(std::memory_order_relaxed) > 0; }
+	///Run fn in the worker pool if worthIt is true and a thread is available
+	template<typename T_FUNC>
+	Future<typename std::invoke_result<T_FUNC>::type> async(bool worthIt, T_FUNC fn) {
+		using ResultType = typename std::invoke_result<T_FUNC>::type;
+		auto task = std::make_shared<Task<ResultType>>(std::move(fn));
+		if (worthIt && acquire()) {
+			//The budget is shared with the pool since the caller may have finished when a worker drops a claimed task
+			WorkerPool::instance().push([free = m_free, task]() {
+				if (task->claim()) {
+					task->run();
+				}
+				free->fetch_add(1, std::memory_order_acq_rel);
+			});
+		}
+		return Future<ResultType>(task);
+	}
+private:
+	bool acquire() {
+		int32_t cur = m_free->load(std::memory_order_relaxed);
+		while (cur > 0) {
+			if (m_free->compare_exchange_weak(cur, cur-1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	std::shared_ptr<std::atomic<int32_t>> m_free;
+};
+
+}//end namespace hic::detail
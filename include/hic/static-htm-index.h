@@ -14,6 +14,19 @@
 
 #include <liboscar/AdvancedOpTree.h>
 
+#include <hic/ThreadBudget.h>
+#include <hic/SpatialGridCovering.h>
+#include <hic/SpatialGridCells.h>
+#include <hic/HcqrOpTree.h>
+#include <hic/Deadline.h>
+
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+#include <array>
+
 
 namespace hic {
 	class OscarSearchSgIndex;
@@ -21,19 +34,37 @@ namespace hic {
 
 namespace hic::Static {
 	class OscarSearchHCQRTextIndexCreator;
+	class SerializedHcqrTextIndex;
 }
 
 namespace hic::Static {
 
 /**
- *  struct OscarSearchSgIndex: Version(2) {
+ *  struct OscarSearchSgIndex: Version(4) {
  *      uint<8> supportedQueries;
  *      SpatialGridInfo htmInfo;
  *      sserialize::Static::FlatTrieBase trie;
  *      sserialize::Static::Array<sserialize::Static::CellTextCompleter::Payload> mixed;
  *      sserialize::Static::Array<sserialize::Static::CellTextCompleter::Payload> regions;
  *      sserialize::Static::Array<sserialize::Static::CellTextCompleter::Payload> items;
+ *      //Version(3)
+ *      sserialize::Static::Map<uint32_t, uint32_t> regionStoreId2GhId;
+ *      //ghId -> cells covered by the region, only QT_EXACT is set
+ *      sserialize::Static::Array<sserialize::Static::CellTextCompleter::Payload> regionCells;
+ *      //Version(4)
+ *      uint<8> features;
+ *      if (features & F_ITEM_CELLS) {
+ *          //item id -> range in itemCells, itemCount+1 entries
+ *          sserialize::BoundedCompactUintArray itemCellsBegin;
+ *          //sorted compressed cell ids of each item
+ *          sserialize::BoundedCompactUintArray itemCells;
+ *      }
+ *      if (features & F_REGION_EXCLUSIVE_CELLS) {
+ *          //ghId -> cells not covered by a child region, only QT_EXACT is set
+ *          sserialize::Static::Array<sserialize::Static::CellTextCompleter::Payload> regionExclusiveCells;
+ *      }
  *  };
+ *  Versions 2 and 3 are supported as well but lack the region cells or the item cells respectively.
  **/
 
 class OscarSearchSgIndex: public sserialize::RefCountObject {
@@ -43,10 +74,25 @@ public:
 	using Trie = sserialize::Static::UnicodeTrie::FlatTrieBase;
 	using Payloads = sserialize::Static::Array<Payload>;
 	using SpatialGridInfo = sserialize::spatial::dgg::Static::SpatialGridInfo;
+	using RegionStoreIdMap = sserialize::Static::Map<uint32_t, uint32_t>;
 public:
     struct MetaData {
-        static constexpr uint8_t version{2};
+        static constexpr uint8_t version{4};
+        static constexpr uint8_t minVersion{2};
     };
+	enum Features { F_NONE=0x0, F_ITEM_CELLS=0x1, F_REGION_EXCLUSIVE_CELLS=0x2 };
+	///Payloads a string query is resolved against, see complete(), items() and regions()
+	enum PayloadSource { PS_MIXED, PS_ITEMS, PS_REGIONS };
+	struct StringQuery {
+		std::string qstr;
+		sserialize::StringCompleter::QuerryType qt;
+		PayloadSource source;
+	};
+	///Number of string queries resolved together by complete(std::vector<StringQuery>)
+	static constexpr std::size_t PrefetchGroupSize = 16;
+	///true iff the item lies within the queried region, used to refine the items of boundary cells.
+	///The index has no item geometry, so this has to be provided by the caller
+	using ItemFilter = std::function<bool(uint32_t itemId)>;
 public:
     static sserialize::RCPtrWrapper<Self> make(const sserialize::UByteArrayAdapter & d, const sserialize::Static::ItemIndexStore & idxStore);
     virtual ~OscarSearchSgIndex() override;
@@ -63,11 +109,98 @@ public:
 	T_CQR_TYPE items(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const;
 	template<typename T_CQR_TYPE>
 	T_CQR_TYPE regions(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const;
+	///Results of many independent string queries in the order of queries.
+	///Queries are resolved in groups of PrefetchGroupSize in stages: trie lookups, payload decoding and result construction.
+	///Each stage requests the data of the next stage of all queries of the group before any of it is used,
+	///so that page faults into the mapped payloads and the index store of different queries overlap.
+	template<typename T_CQR_TYPE>
+	std::vector<T_CQR_TYPE> complete(std::vector<StringQuery> const & queries) const;
 public:
+	///Number of cells returned by the respective query.
+	///Only the payload header and the sizes of the cell indexes are read
+	uint32_t completeCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const;
+	uint32_t itemsCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const;
+	uint32_t regionsCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const;
+public:
+	///The compressed cell cellId as full-match cell
 	template<typename T_CQR_TYPE>
 	T_CQR_TYPE cell(uint32_t cellId) const;
+	///Cells covered by the region with the store id regionId
 	template<typename T_CQR_TYPE>
 	T_CQR_TYPE region(uint32_t regionId) const;
+	///Cells of the region with the store id regionId that are not covered by any of its child regions
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE regionExclusiveCells(uint32_t regionId) const;
+	///Full-match cells given by their compressed cell ids in any order, invalid ids are skipped
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE cells(std::vector<uint32_t> cellIds) const;
+	///Union of the cells covered by the regions in cqr.
+	///Regions are looked up in the index of each cell, cqr is not flattened
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE in(T_CQR_TYPE const & cqr) const;
+	///Union of the cells of the regions with the given store ids
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE regions(std::vector<uint32_t> const & storeIds) const;
+	///Cells of the item as partial-match cells containing only the item
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE item(uint32_t itemId) const;
+	///Full-match cells of the most relevant item of cqr, i.e. the one with the smallest id.
+	///Regions are resolved to their region cells if available
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE relevantElement(T_CQR_TYPE const & cqr) const;
+	///Cells completely inside rect are full-match cells.
+	///Cells intersecting its boundary are partial-match cells, see polygon()
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE rect(sserialize::spatial::GeoRect const & rect, ItemFilter const & refine = ItemFilter()) const;
+	///Cells completely inside the polygon are full-match cells.
+	///Cells intersecting its boundary are partial-match cells containing their items accepted by refine.
+	///Without refine they contain all their items, i.e. the boundary is only resolved up to the cells
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE polygon(std::vector<sserialize::spatial::GeoPoint> const & points, ItemFilter const & refine = ItemFilter()) const;
+	///Cells within radius meters of the path, see polygon()
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE path(double radius, std::vector<sserialize::spatial::GeoPoint> const & points, ItemFilter const & refine = ItemFilter()) const;
+	///Interior pixels as full-match cells, boundary pixels as partial-match cells with their items accepted by refine.
+	///Boundary cells without accepted items are dropped
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE cells(hic::SpatialGridCovering const & covering, ItemFilter const & refine = ItemFilter()) const;
+	///Full-match cells given by their sorted compressed cell ids
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE fullMatchCells(std::vector<uint32_t> const & cellIds) const;
+	///Cells within distance meters of the cells of cqr as full-match cells.
+	///The cells of cqr are only part of the result if withSource is true
+	template<typename T_CQR_TYPE>
+	T_CQR_TYPE near(T_CQR_TYPE const & cqr, double distance, bool withSource) const;
+public:
+	///Sorted compressed cell ids within distance meters of cellIds by expanding the grid neighbourhood, see near()
+	std::vector<uint32_t> nearCellIds(std::vector<uint32_t> const & cellIds, double distance, bool withSource) const;
+	static std::vector<uint32_t> cellIds(sserialize::CellQueryResult const & cqr);
+	static std::vector<uint32_t> cellIds(sserialize::TreedCellQueryResult const & cqr);
+public:
+	inline bool hasRegionCells() const { return m_version >= 3; }
+	inline bool hasItemCells() const { return m_features & F_ITEM_CELLS; }
+	inline bool hasRegionExclusiveCells() const { return m_features & F_REGION_EXCLUSIVE_CELLS; }
+	///Sorted compressed cell ids of the cells containing itemId
+	std::vector<uint32_t> itemCellIds(uint32_t itemId) const;
+	///Store ids of the regions in items
+	std::vector<uint32_t> regionStoreIds(sserialize::ItemIndex const & items) const;
+	///Sorted store ids of the regions in the cells of cqr
+	std::vector<uint32_t> regionStoreIds(sserialize::CellQueryResult const & cqr) const;
+	std::vector<uint32_t> regionStoreIds(sserialize::TreedCellQueryResult const & cqr) const;
+	///True if itemId is the store id of a region with region cells
+	bool isRegion(uint32_t itemId) const;
+	static sserialize::ItemIndex flaten(sserialize::CellQueryResult const & cqr);
+	static sserialize::ItemIndex flaten(sserialize::TreedCellQueryResult const & cqr);
+	///Smallest item id of cqr, i.e. the minimum of the first items of its cells, without flattening it.
+	///Returns std::numeric_limits<uint32_t>::max() if cqr has no items
+	static uint32_t minItemId(sserialize::CellQueryResult const & cqr);
+	static uint32_t minItemId(sserialize::TreedCellQueryResult const & cqr);
+public:
+	///Sorted compressed cell ids of the cells at or below the given grid pixels.
+	///Pixels without items are not part of the index and skipped
+	std::vector<uint32_t> cellIds(std::vector<sserialize::spatial::dgg::interface::SpatialGrid::PixelId> const & pixels) const;
+	///Cells of the index and their ancestors in the grid, created on first use
+	std::shared_ptr<hic::SpatialGridCells const> const & sgCells() const;
 public:
 	inline SpatialGridInfo const & sgInfo() const { return *m_sgInfo; }
 	inline std::shared_ptr<SpatialGridInfo> const & sgInfoPtr() const { return m_sgInfo; }
@@ -76,10 +209,19 @@ public:
 	inline Trie const & trie() const { return m_trie; }
 private:
 	friend class OscarSearchHCQRTextIndexCreator;
+	friend class SerializedHcqrTextIndex;
 private:
     OscarSearchSgIndex(const sserialize::UByteArrayAdapter & d, const sserialize::Static::ItemIndexStore & idxStore);
 private:
     Payload::Type typeFromCompletion(const std::string& qs, const sserialize::StringCompleter::QuerryType qt, Payloads const & pd) const;
+	///Position of the payload of qs in the trie or Trie::npos
+	sserialize::UByteArrayAdapter::SizeType position(const std::string& qs, const sserialize::StringCompleter::QuerryType qt) const;
+	///Payload type matching qt, throws sserialize::OutOfBoundsException if there is none
+	static Payload::Type typeFromPayload(Payload const & p, const sserialize::StringCompleter::QuerryType qt);
+	///Query type of a payload with the given types that answers qt, throws sserialize::OutOfBoundsException if there is none
+	static sserialize::StringCompleter::QuerryType payloadQueryType(int types, const sserialize::StringCompleter::QuerryType qt);
+	Payloads const & payloads(PayloadSource source) const;
+	uint32_t cellCount(const std::string& qs, const sserialize::StringCompleter::QuerryType qt, Payloads const & pd) const;
 private:
     char m_sq;
 	std::shared_ptr<SpatialGridInfo> m_sgInfo;
@@ -87,9 +229,18 @@ private:
 	Payloads m_mixed;
 	Payloads m_regions;
 	Payloads m_items;
+	RegionStoreIdMap m_regionStoreIds;
+	Payloads m_regionCells;
+	int m_features{F_NONE};
+	sserialize::BoundedCompactUintArray m_itemCellsBegin;
+	sserialize::BoundedCompactUintArray m_itemCells;
+	Payloads m_regionExclusiveCells;
+	uint8_t m_version;
     sserialize::Static::ItemIndexStore m_idxStore;
 	sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::SpatialGrid> m_sg;
     int m_flags{ sserialize::CellQueryResult::FF_CELL_GLOBAL_ITEM_IDS };
+	mutable std::once_flag m_sgCellsFlag;
+	mutable std::shared_ptr<hic::SpatialGridCells const> m_sgCells;
 };
 
 class HCQROscarCellIndex: public sserialize::spatial::dgg::detail::HCQRIndexFromCellIndex::interface::CellIndex {
@@ -104,11 +255,25 @@ public:
 public:
 	CellQueryResult cell(uint32_t cellId) const override;
 	CellQueryResult region(uint32_t regionId) const override;
+public:
+	///Needs an index with item cells, see OscarSearchSgIndex::hasItemCells()
+	CellQueryResult item(uint32_t itemId) const;
 private:
 	sserialize::RCPtrWrapper<OscarSearchSgIndex> m_base;
 };
 
 class OscarSearchHCQRTextIndexCreator {
+public:
+	///Format of the trees in the payloads and hence of dest
+	enum TreeFormat : uint8_t {
+		///sserialize::spatial::dgg::Static::HCQRTextIndex
+		TF_HCQR_SPATIAL_GRID=0,
+		///SerializedHcqrTextIndex, trees are not compactified
+		TF_SERIALIZED_HCQR=1,
+		///SerializedHcqrTextIndex with SuccinctHcqr trees, trees are not compactified.
+		///Queries decode these trees in full, only TF_SERIALIZED_HCQR trees are accessed lazily
+		TF_SUCCINCT_HCQR=2
+	};
 public:
 	sserialize::UByteArrayAdapter dest;
 	sserialize::ItemIndexFactory idxFactory; //empty
@@ -118,6 +283,13 @@ public:
 	bool compactTree{false};
 	uint32_t compactLevel{std::numeric_limits<uint32_t>::max()};
 	uint32_t threads{0};
+	///Maximum number of bytes of serialized trees and their keys kept to reuse them for payloads with the same cells and items, 0 disables reuse.
+	///TF_SERIALIZED_HCQR and TF_SUCCINCT_HCQR only keep the location of each tree and store reused trees as references to it
+	std::size_t payloadCacheBytes{std::size_t(1) << 30};
+	///Maximum number of finished payloads per pass waiting for a preceding one before workers block
+	uint32_t maxPendingPayloads{4096};
+	///compactify and compactTree are only supported by TF_HCQR_SPATIAL_GRID
+	TreeFormat treeFormat{TF_HCQR_SPATIAL_GRID};
 public:
 	void run();
 };
@@ -142,34 +314,229 @@ private:
 	sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> m_d;
 };
 
+///k-way merge of the item lists of the cells of a CellQueryResult.
+///Yields every item exactly once in ascending order without materializing the whole result.
+///No item list is fetched before the first access. The first one needs the first item of every cell,
+///so each cell is then fetched once and released as soon as its items are exhausted.
+class CellQueryResultItemMerger final {
+public:
+	CellQueryResultItemMerger(sserialize::CellQueryResult const & cqr);
+	~CellQueryResultItemMerger();
+public:
+	inline bool valid() const { fetch(); return m_heap.size(); }
+	inline uint32_t get() const { fetch(); return m_heap.front().first; }
+	void next();
+private:
+	struct Cursor {
+		sserialize::ItemIndex idx;
+		sserialize::ItemIndex::const_iterator it;
+		sserialize::ItemIndex::const_iterator end;
+	};
+	using HeapEntry = std::pair<uint32_t, std::size_t>;
+	static bool heapCmp(HeapEntry const & a, HeapEntry const & b) { return a.first > b.first; }
+private:
+	///Fetches the item lists of the cells and builds the heap on the first call
+	inline void fetch() const { if (m_cqr.cellCount()) { init(); } }
+	void init() const;
+	void advance(std::size_t cursor);
+private:
+	///Cells whose item lists were not fetched yet, empty once init() was called
+	mutable sserialize::CellQueryResult m_cqr;
+	mutable std::vector<Cursor> m_cursors;
+	///min-heap of (current item, cursor)
+	mutable std::vector<HeapEntry> m_heap;
+};
+
 }//end namespace detail
 
+///Lazily iterates over the items of a CellQueryResult in ascending order.
+///Only the cells' item lists are read, the result is never materialized.
+class CellQueryResultItemIterator final {
+public:
+	CellQueryResultItemIterator();
+	CellQueryResultItemIterator(sserialize::CellQueryResult const & cqr);
+	~CellQueryResultItemIterator();
+public:
+	bool valid() const;
+	uint32_t operator*() const;
+	CellQueryResultItemIterator & operator++();
+public:
+	///Skips up to count items, returns the number of skipped items
+	uint32_t skip(uint32_t count);
+	///Appends up to count items to out, returns the number of appended items
+	template<typename T_OUTPUT_ITERATOR>
+	uint32_t take(uint32_t count, T_OUTPUT_ITERATOR out) {
+		uint32_t result = 0;
+		for(; result < count && valid(); ++result, ++out) {
+			*out = operator*();
+			operator++();
+		}
+		return result;
+	}
+private:
+	std::shared_ptr<detail::CellQueryResultItemMerger> m_d;
+};
+
 class SgOpTree: public liboscar::AdvancedOpTree {
+public:
+	using KeyMap = std::unordered_map<const Node*, std::string>;
+	///canonical key of a subtree -> its result
+	template<typename TCQRType>
+	using ResultCache = std::unordered_map<std::string, TCQRType>;
 public:
     SgOpTree(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d);
     virtual ~SgOpTree() {}
 public:
+	///Subtrees are evaluated in parallel if threadCount > 1 and their estimated size is at least ParallelCellThreshold
+	template<typename TCQRType>
+    TCQRType calc(uint32_t threadCount = 1) {
+		return calc<TCQRType>(root(), threadCount);
+	}
+	///Result of the subtree rooted at node which has to be part of this tree
 	template<typename TCQRType>
-    TCQRType calc() {
-		return Calc<TCQRType>(m_d).calc(root());
+    TCQRType calc(const Node * node, uint32_t threadCount) {
+		Calc<TCQRType> c(m_d, threadCount, m_deadline);
+		if (m_clip) {
+			c.setClip(m_d->rect<TCQRType>(*m_clip));
+		}
+		c.setRefinement(m_refinement);
+		c.prepare(node);
+		return c.calc(node);
 	}
+	///Result of the query where leaves found in cache are not evaluated again
+	template<typename TCQRType>
+	TCQRType calc(ResultCache<TCQRType> const & cache, uint32_t threadCount) {
+		Calc<TCQRType> c(m_d, threadCount, m_deadline);
+		if (m_clip) {
+			c.setClip(m_d->rect<TCQRType>(*m_clip));
+		}
+		c.setRefinement(m_refinement);
+		c.prepare(root());
+		std::vector<const Node*> nodes;
+		leaves(nodes);
+		KeyMap keys;
+		for(const Node * node : nodes) {
+			auto it = cache.find(SgOpTree::canonicalKey(node, keys));
+			if (it != cache.end()) {
+				c.seed(node, it->second);
+			}
+		}
+		return c.calc(root());
+	}
+	///Appends all leaves of the query to dest
+	void leaves(std::vector<const Node*> & dest) const;
+	///Restrict the result to cells intersecting rect.
+	///Leaves are clipped before any set operation is applied.
+	void clip(sserialize::spatial::GeoRect const & rect);
+	///Filter for the items of the boundary cells of a RECT, POLYGON or PATH leaf, see OscarSearchSgIndex::polygon()
+	using Refinement = std::function<OscarSearchSgIndex::ItemFilter(const Node * leaf)>;
+	///Boundary cells of spatial leaves keep all their items if no refinement is set
+	void refinement(Refinement const & r) { m_refinement = r; }
+	///Evaluation throws a hic::TimeoutException once deadline expired.
+	///It is checked before evaluating a subtree and between set operations.
+	void deadline(hic::Deadline const & deadline) { m_deadline = deadline; }
+	///Canonical form of the query. Operands of commutative set operations are sorted
+	///and nested chains of the same operation are flattened.
+	///Queries differing only in operand order or grouping have the same key.
+	std::string canonicalKey() const;
+	///The last string leaf of the query if it is connected to the root by intersections only, otherwise nullptr.
+	///The result of the query is then a subset of the result of this leaf.
+	const Node * refinableLeaf() const;
+public:
+	///true iff every item matching leaf also matches prev, i.e. leaf extends the prefix or substring query prev
+	static bool refines(const Node * prev, const Node * leaf);
+	///Canonical form of the subtree rooted at node, keys of all visited nodes are stored in keys
+	static std::string const & canonicalKey(const Node * node, KeyMap & keys);
+	///Set operation of node with ' ' mapped to '/'
+	static char setOp(const Node * node);
+	///true iff node is a set operation whose operands can be reordered and regrouped
+	static bool isCommutativeSetOp(const Node * node);
+	///Collects the operands of the flattened chain of set operations op rooted at node
+	static void operands(const Node * node, char op, std::vector<const Node*> & dest);
+public:
+	///Value of estimated sizes that are not known in advance
+	static constexpr uint32_t UnknownSize = std::numeric_limits<uint32_t>::max();
+	///Minimum estimated number of cells of a subtree to be evaluated by another thread
+	static constexpr uint32_t ParallelCellThreshold = 1024;
 private:
 	template<typename TCQRType>
     class Calc final {
     public:
         using CQRType = TCQRType;
     public:
-        Calc(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d) : m_d(d) {}
+        Calc(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d, uint32_t threadCount, hic::Deadline const & deadline) :
+        m_d(d), m_tb(threadCount), m_deadline(deadline) {}
         ~Calc() {}
+		///Computes the keys of all nodes of the tree rooted at node.
+		///Has to be called before calc since keys are not modified during a parallel evaluation
+		void prepare(const Node * node);
+		void setClip(CQRType const & clip) { m_clip = std::make_unique<CQRType>(clip); }
+		void setRefinement(Refinement const & r) { m_refinement = r; }
+		///Use result for node instead of computing it, clipped like a computed leaf
+		void seed(const Node * node, CQRType const & result);
         CQRType calc(const Node * node);
+    private:
+		CQRType calcNode(const Node * node);
+		CQRType calcCommutativeSetOp(const Node * node);
+		///Evaluates nodes, possibly in parallel
+		std::vector<CQRType> calc(std::vector<const Node*> const & nodes);
+		///Unites results pairwise, possibly in parallel
+		CQRType unite(std::vector<CQRType> results);
+		///Upper bound of the number of cells of the result of the subtree rooted at node
+		///computed from payload headers only
+		uint32_t estimate(const Node * node);
     private:
         sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> m_d;
+		KeyMap m_keys;
+		///canonical key of a subtree -> result of that subtree, shared by identical subtrees of a query
+		std::unordered_map<std::string, CQRType> m_cache;
+		///canonical key of a subtree -> estimated cell count
+		std::unordered_map<std::string, uint32_t> m_estimates;
+		///protects m_cache and m_estimates
+		std::mutex m_lock;
+		hic::detail::ThreadBudget m_tb;
+		std::unique_ptr<CQRType> m_clip;
+		Refinement m_refinement;
+		const Node * m_root{0};
+		hic::Deadline m_deadline;
     };
 private:
     sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> m_d;
+	std::unique_ptr<sserialize::spatial::GeoRect> m_clip;
+	Refinement m_refinement;
+	hic::Deadline m_deadline;
+};
+
+///Incremental evaluation of as-you-type queries.
+///If a query only extends the last prefix or substring term of the previous query,
+///the previous result is intersected with the result of the new term instead of evaluating the whole query again.
+class OscarSearchSgCompleterSession {
+public:
+	OscarSearchSgCompleterSession(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d);
+	~OscarSearchSgCompleterSession();
+public:
+	sserialize::CellQueryResult complete(std::string const & str, uint32_t threadCount = 1);
+	///Forget the previous query
+	void reset();
+	///true iff the last call of complete() reused the previous result
+	inline bool refined() const { return m_refined; }
+private:
+	sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> m_d;
+	std::string m_str;
+	sserialize::CellQueryResult m_cqr;
+	bool m_valid{false};
+	bool m_refined{false};
 };
 
 class OscarSearchSgCompleter {
+public:
+	enum CountMode {
+		///Number of distinct items, item lists are merged but never materialized
+		CM_EXACT,
+		///Sum of the cell sizes, only index headers are read.
+		///This is an upper bound since items spanning multiple cells are counted multiple times
+		CM_ESTIMATE
+	};
 public:
 	OscarSearchSgCompleter() {}
 	~OscarSearchSgCompleter() {}
@@ -179,14 +546,77 @@ public:
 	inline hic::Static::OscarSearchSgIndex const & index() const { return *m_d; }
 	sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & indexPtr() const { return m_d; }
 public:
-	sserialize::CellQueryResult complete(std::string const & str, bool treedCqr, uint32_t threadCount);
+	///Throws a hic::TimeoutException if deadline expires before the result is known
+	sserialize::CellQueryResult complete(std::string const & str, bool treedCqr, uint32_t threadCount, hic::Deadline const & deadline = hic::Deadline());
+	///Result restricted to items in cells intersecting viewport
+	sserialize::CellQueryResult complete(std::string const & str, sserialize::spatial::GeoRect const & viewport, bool treedCqr, uint32_t threadCount, hic::Deadline const & deadline = hic::Deadline());
+	uint32_t count(std::string const & str, CountMode cm, uint32_t threadCount, hic::Deadline const & deadline = hic::Deadline());
+	///Items of the query in ascending order, computed lazily
+	CellQueryResultItemIterator iterate(std::string const & str, uint32_t threadCount);
+	///Up to limit items of the query in ascending order starting with the item at position offset
+	std::vector<uint32_t> items(std::string const & str, uint32_t offset, uint32_t limit, uint32_t threadCount);
+	OscarSearchSgCompleterSession session() const;
+	///Results of many queries in the order of strs.
+	///Leaves shared by several queries are resolved only once and in the order of their query strings
+	///to access neighbouring parts of the trie together. Queries are evaluated by threadCount threads.
+	std::vector<sserialize::CellQueryResult> complete(std::vector<std::string> const & strs, uint32_t threadCount);
+public:
+	///Distance in meters of an item to the query point.
+	///The index has no item geometry, so this has to be provided by the caller
+	using ItemDistance = std::function<double(uint32_t itemId)>;
+	struct Neighbour {
+		uint32_t itemId;
+		double distance;
+	};
+	///The k items of the query nearest to (lat, lon) in ascending order of their distance
+	std::vector<Neighbour> knn(std::string const & str, double lat, double lon, uint32_t k, ItemDistance const & distance, uint32_t threadCount);
+public:
+	///Number of items of a result of this index, see CountMode
+	uint32_t count(sserialize::CellQueryResult const & cqr, CountMode cm, hic::Deadline const & deadline = hic::Deadline()) const;
+	///Item counts of cqr aggregated at the pixels of the given level in ascending order of their pixel id.
+	///Only cell sizes and index headers are read, items spanning multiple cells are counted once per cell
+	std::vector<hic::PixelCount> heatmap(sserialize::CellQueryResult const & cqr, uint32_t level) const;
+	///Expands rings of grid neighbours around the cell containing (lat, lon) and only evaluates distances of items in cells of cqr.
+	///Stops as soon as the k-th distance is at most the minimal distance of the next ring
+	std::vector<Neighbour> knn(sserialize::CellQueryResult const & cqr, double lat, double lon, uint32_t k, ItemDistance const & distance) const;
 private:
 	sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> m_d;
 };
 
+class HCQROscarSpatialOps: public hic::interface::HcqrSpatialOps {
+public:
+	HCQROscarSpatialOps(sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base);
+	~HCQROscarSpatialOps() override;
+public:
+	HCQRPtr polygon(std::vector<sserialize::spatial::GeoPoint> const & points) const override;
+	HCQRPtr path(double radius, std::vector<sserialize::spatial::GeoPoint> const & points) const override;
+	HCQRPtr near(HCQRPtr const & hcqr, double distance, bool withSource) const override;
+	HCQRPtr item(uint32_t itemId) const override;
+	HCQRPtr relevantElement(HCQRPtr const & hcqr) const override;
+	HCQRPtr in(HCQRPtr const & hcqr) const override;
+	std::vector<HCQRPtr> const & rootRegions() const override;
+	HCQRPtr rect(sserialize::spatial::GeoRect const & rect) const override;
+	HCQRPtr cells(std::vector<uint32_t> const & cellIds) const override;
+	HCQRPtr regionExclusiveCells(uint32_t regionId) const override;
+	std::vector<hic::PixelCount> heatmap(HCQRPtr const & hcqr, uint32_t level) const override;
+private:
+	HCQRPtr toHCQR(sserialize::CellQueryResult const & cqr) const;
+	///Calls f with the items of every leaf of hcqr, full-match leaves with the items of each of their cells
+	void leafItems(HCQRPtr const & hcqr, std::function<void(sserialize::ItemIndex const &)> const & f) const;
+private:
+	sserialize::RCPtrWrapper<OscarSearchSgIndex> m_base;
+	sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::SpatialGridInfo> m_sgi;
+	mutable std::once_flag m_rootRegionsFlag;
+	mutable std::vector<HCQRPtr> m_rootRegions;
+};
+
 sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQRIndex>
 makeOscarSearchSgHCQRIndex(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d);
 
+///Spatial operations matching the HCQRs of makeOscarSearchSgHCQRIndex
+sserialize::RCPtrWrapper<hic::interface::HcqrSpatialOps>
+makeOscarSearchSgHCQRSpatialOps(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d);
+
 }//end namespace hic::Static
 
 //BEGIN Template function implementations
@@ -200,6 +630,204 @@ SgOpTree::Calc<TCQRType>::Calc::calc(const Node * node) {
     if (!node) {
         return CQRType();
     }
+	m_deadline.check("SgOpTree");
+	std::string const & key = SgOpTree::canonicalKey(node, m_keys);
+	{
+		std::lock_guard<std::mutex> lck(m_lock);
+		auto it = m_cache.find(key);
+		if (it != m_cache.end()) {
+			return it->second;
+		}
+	}
+	CQRType result = calcNode(node);
+	if (m_clip && (node->baseType == Node::LEAF || node == m_root)) {
+		result = result / *m_clip;
+	}
+	{
+		std::lock_guard<std::mutex> lck(m_lock);
+		m_cache.emplace(key, result);
+	}
+	return result;
+}
+
+template<typename TCQRType>
+void
+SgOpTree::Calc<TCQRType>::Calc::seed(const Node * node, CQRType const & result) {
+	std::string const & key = SgOpTree::canonicalKey(node, m_keys);
+	if (m_clip && (node->baseType == Node::LEAF || node == m_root)) {
+		m_cache.emplace(key, result / *m_clip);
+	}
+	else {
+		m_cache.emplace(key, result);
+	}
+}
+
+template<typename TCQRType>
+void
+SgOpTree::Calc<TCQRType>::Calc::prepare(const Node * node) {
+	m_root = node;
+	SgOpTree::canonicalKey(node, m_keys);
+}
+
+template<typename TCQRType>
+std::vector<typename SgOpTree::Calc<TCQRType>::CQRType>
+SgOpTree::Calc<TCQRType>::Calc::calc(std::vector<const Node*> const & nodes) {
+	std::vector<hic::detail::ThreadBudget::Future<CQRType>> tasks;
+	for(const Node * node : nodes) {
+		tasks.emplace_back(m_tb.async(m_tb.parallel() && estimate(node) >= SgOpTree::ParallelCellThreshold, [this, node]() {
+			return calc(node);
+		}));
+	}
+	std::vector<CQRType> results;
+	for(auto & x : tasks) {
+		results.emplace_back(x.get());
+	}
+	return results;
+}
+
+template<typename TCQRType>
+typename SgOpTree::Calc<TCQRType>::CQRType
+SgOpTree::Calc<TCQRType>::Calc::unite(std::vector<CQRType> results) {
+	while (results.size() > 1) {
+		std::vector<hic::detail::ThreadBudget::Future<CQRType>> tasks;
+		for(std::size_t i(0), s(results.size()); i+1 < s; i += 2) {
+			CQRType const & a = results[i];
+			CQRType const & b = results[i+1];
+			bool worthIt = a.cellCount() >= SgOpTree::ParallelCellThreshold && b.cellCount() >= SgOpTree::ParallelCellThreshold;
+			tasks.emplace_back(m_tb.async(worthIt, [&a, &b]() {
+				return a + b;
+			}));
+		}
+		std::vector<CQRType> next;
+		for(auto & x : tasks) {
+			next.emplace_back(x.get());
+		}
+		m_deadline.check("SgOpTree");
+		if (results.size() % 2) {
+			next.emplace_back(std::move(results.back()));
+		}
+		results = std::move(next);
+	}
+	return results.size() ? results.front() : CQRType();
+}
+
+template<typename TCQRType>
+typename SgOpTree::Calc<TCQRType>::CQRType
+SgOpTree::Calc<TCQRType>::Calc::calcCommutativeSetOp(const Node * node) {
+	char op = SgOpTree::setOp(node);
+	std::vector<const Node*> ops;
+	SgOpTree::operands(node, op, ops);
+	if (op == '/') {
+		//Intersect smallest operands first, the intermediate result is bounded by the smallest operand
+		std::vector<std::pair<uint32_t, const Node*>> plan;
+		for(const Node * x : ops) {
+			plan.emplace_back(estimate(x), x);
+		}
+		std::sort(plan.begin(), plan.end(), [this](std::pair<uint32_t, const Node*> const & a, std::pair<uint32_t, const Node*> const & b) {
+			if (a.first != b.first) {
+				return a.first < b.first;
+			}
+			return SgOpTree::canonicalKey(a.second, m_keys) < SgOpTree::canonicalKey(b.second, m_keys);
+		});
+		if (m_tb.parallel() && plan.front().first >= SgOpTree::ParallelCellThreshold) {
+			//All operands are large. Fetching them concurrently outweighs stopping early.
+			std::vector<const Node*> nodes;
+			for(auto const & x : plan) {
+				nodes.push_back(x.second);
+			}
+			std::vector<CQRType> results = calc(nodes);
+			CQRType result = results.front();
+			for(std::size_t i(1), s(results.size()); i < s && result.cellCount(); ++i) {
+				m_deadline.check("SgOpTree");
+				result = result / results[i];
+			}
+			return result;
+		}
+		CQRType result = calc(plan.front().second);
+		for(std::size_t i(1), s(plan.size()); i < s && result.cellCount(); ++i) {
+			result = result / calc(plan[i].second);
+		}
+		return result;
+	}
+	std::sort(ops.begin(), ops.end(), [this](const Node * a, const Node * b) {
+		return SgOpTree::canonicalKey(a, m_keys) < SgOpTree::canonicalKey(b, m_keys);
+	});
+	return unite(calc(ops));
+}
+
+template<typename TCQRType>
+uint32_t
+SgOpTree::Calc<TCQRType>::Calc::estimate(const Node * node) {
+	if (!node) {
+		return 0;
+	}
+	std::string const & key = SgOpTree::canonicalKey(node, m_keys);
+	{
+		std::lock_guard<std::mutex> lck(m_lock);
+		auto it = m_estimates.find(key);
+		if (it != m_estimates.end()) {
+			return it->second;
+		}
+		if (m_cache.count(key)) {
+			uint32_t result = m_cache.at(key).cellCount();
+			m_estimates.emplace(key, result);
+			return result;
+		}
+	}
+	auto saturatingAdd = [](uint32_t a, uint32_t b) -> uint32_t {
+		return (a > SgOpTree::UnknownSize - b ? SgOpTree::UnknownSize : a+b);
+	};
+	uint32_t result = SgOpTree::UnknownSize;
+	if (node->baseType == Node::LEAF) {
+		switch (node->subType) {
+		case Node::STRING:
+		case Node::STRING_REGION:
+		case Node::STRING_ITEM:
+		{
+			if (!node->value.size()) {
+				result = 0;
+				break;
+			}
+			std::string qstr(node->value);
+			sserialize::StringCompleter::QuerryType qt = sserialize::StringCompleter::normalize(qstr);
+			if (node->subType == Node::STRING_ITEM) {
+				result = m_d->itemsCellCount(qstr, qt);
+			}
+			else if (node->subType == Node::STRING_REGION) {
+				result = m_d->regionsCellCount(qstr, qt);
+			}
+			else {
+				result = m_d->completeCellCount(qstr, qt);
+			}
+			break;
+		}
+		default:
+			break;
+		};
+	}
+	else if (node->baseType == Node::UNARY_OP && node->subType == Node::FM_CONVERSION_OP) {
+		result = estimate(node->children.at(0));
+	}
+	else if (node->baseType == Node::BINARY_OP && node->subType == Node::SET_OP) {
+		char op = SgOpTree::setOp(node);
+		if (op == '+' || op == '^') {
+			result = saturatingAdd(estimate(node->children.front()), estimate(node->children.back()));
+		}
+		else if (op == '/') {
+			result = std::min(estimate(node->children.front()), estimate(node->children.back()));
+		}
+		else if (op == '-') {
+			result = estimate(node->children.front());
+		}
+	}
+	std::lock_guard<std::mutex> lck(m_lock);
+	m_estimates.emplace(key, result);
+	return result;
+}
+
+template<typename TCQRType>
+typename SgOpTree::Calc<TCQRType>::CQRType
+SgOpTree::Calc<TCQRType>::Calc::calcNode(const Node * node) {
 	switch (node->baseType) {
 	case Node::LEAF:
 		switch (node->subType) {
@@ -225,23 +853,26 @@ SgOpTree::Calc<TCQRType>::Calc::calc(const Node * node) {
 			}
 		}
 		case Node::REGION:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: region");
+			return m_d->region<CQRType>(std::atoi(node->value.c_str()));
 		case Node::REGION_EXCLUSIVE_CELLS:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: region exclusive cells");
+			return m_d->regionExclusiveCells<CQRType>(std::atoi(node->value.c_str()));
 		case Node::CELL:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: cell");
+			return m_d->cell<CQRType>(std::atoi(node->value.c_str()));
 		case Node::CELLS:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: cells");
+			return m_d->cells<CQRType>(hic::SpatialGridCoverer::parseCellIds(node->value));
 		case Node::RECT:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: rectangle");
+			return m_d->rect<CQRType>(sserialize::spatial::GeoRect(node->value, true), m_refinement ? m_refinement(node) : OscarSearchSgIndex::ItemFilter());
 		case Node::POLYGON:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: polygon");
+			return m_d->polygon<CQRType>(hic::SpatialGridCoverer::parsePolygon(node->value), m_refinement ? m_refinement(node) : OscarSearchSgIndex::ItemFilter());
 		case Node::PATH:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: path");
+		{
+			auto path = hic::SpatialGridCoverer::parsePath(node->value);
+			return m_d->path<CQRType>(path.first, path.second, m_refinement ? m_refinement(node) : OscarSearchSgIndex::ItemFilter());
+		}
 		case Node::POINT:
 			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: point");
 		case Node::ITEM:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: item");
+			return m_d->item<CQRType>(std::atoi(node->value.c_str()));
 		default:
 			break;
 		};
@@ -251,18 +882,21 @@ SgOpTree::Calc<TCQRType>::Calc::calc(const Node * node) {
 		case Node::FM_CONVERSION_OP:
 			return calc(node->children.at(0)).allToFull();
 		case Node::CELL_DILATION_OP:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: cell dilation");
+		{
+			CQRType child = calc(node->children.at(0));
+			return child + m_d->near(child, std::atof(node->value.c_str()), false);
+		}
 		case Node::REGION_DILATION_BY_ITEM_COVERAGE_OP:
 		case Node::REGION_DILATION_BY_CELL_COVERAGE_OP:
 			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: region dilation");
 		case Node::COMPASS_OP:
 			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: compass");
 		case Node::IN_OP:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: in");
+			return m_d->in(calc(node->children.at(0)));
 		case Node::NEAR_OP:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: near");
+			return m_d->near(calc(node->children.at(0)), std::atof(node->value.c_str()), true);
 		case Node::RELEVANT_ELEMENT_OP:
-			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: relevant item");
+			return m_d->relevantElement(calc(node->children.at(0)));
 		case Node::QUERY_EXCLUSIVE_CELLS:
 			throw sserialize::UnsupportedFeatureException("OscarSearchWithSg: query exclusive cells");
 		default:
@@ -272,16 +906,20 @@ SgOpTree::Calc<TCQRType>::Calc::calc(const Node * node) {
 	case Node::BINARY_OP:
 		switch(node->subType) {
 		case Node::SET_OP:
-			switch (node->value.at(0)) {
+			switch (SgOpTree::setOp(node)) {
 			case '+':
-				return calc(node->children.front()) + calc(node->children.back());
 			case '/':
-			case ' ':
-				return calc(node->children.front()) / calc(node->children.back());
+				return calcCommutativeSetOp(node);
 			case '-':
-				return calc(node->children.front()) - calc(node->children.back());
+			{
+				std::vector<CQRType> ops = calc(std::vector<const Node*>{node->children.front(), node->children.back()});
+				return ops.front() - ops.back();
+			}
 			case '^':
-				return calc(node->children.front()) ^ calc(node->children.back());
+			{
+				std::vector<CQRType> ops = calc(std::vector<const Node*>{node->children.front(), node->children.back()});
+				return ops.front() ^ ops.back();
+			}
 			default:
 				return CQRType();
 			};
@@ -338,18 +976,239 @@ T_CQR_TYPE OscarSearchSgIndex::items(const std::string& qstr, const sserialize::
 	}
 }
 
+template<typename T_CQR_TYPE>
+std::vector<T_CQR_TYPE>
+OscarSearchSgIndex::complete(std::vector<StringQuery> const & queries) const {
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+	using SizeType = sserialize::UByteArrayAdapter::SizeType;
+	auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	auto willNeed = [](sserialize::UByteArrayAdapter d) {
+		d.advice(sserialize::UByteArrayAdapter::AT_WILLNEED, d.size());
+	};
+	//dataAt() extends to the end of the array, only the bytes up to the next payload are requested
+	auto payloadData = [](Payloads const & pd, SizeType pos) {
+		sserialize::UByteArrayAdapter d = pd.dataAt(pos);
+		if (pos+1 < pd.size()) {
+			SizeType rest = pd.dataAt(pos+1).size();
+			if (rest < d.size()) {
+				return sserialize::UByteArrayAdapter(d, 0, d.size()-rest);
+			}
+		}
+		return d;
+	};
+	std::vector<T_CQR_TYPE> result;
+	result.reserve(queries.size());
+	std::array<SizeType, PrefetchGroupSize> positions;
+	std::array<Payload::Type, PrefetchGroupSize> types;
+	std::array<bool, PrefetchGroupSize> valid;
+	for(std::size_t gBegin(0), s(queries.size()); gBegin < s; gBegin += PrefetchGroupSize) {
+		std::size_t gSize = std::min(PrefetchGroupSize, s-gBegin);
+		//trie lookups of the whole group, then request their payloads
+		for(std::size_t i(0); i < gSize; ++i) {
+			StringQuery const & q = queries[gBegin+i];
+			positions[i] = position(q.qstr, q.qt);
+			valid[i] = positions[i] != m_trie.npos;
+		}
+		for(std::size_t i(0); i < gSize; ++i) {
+			if (valid[i]) {
+				willNeed(payloadData(payloads(queries[gBegin+i].source), positions[i]));
+			}
+		}
+		//decode payloads, request cell indexes
+		for(std::size_t i(0); i < gSize; ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			StringQuery const & q = queries[gBegin+i];
+			try {
+				types[i] = typeFromPayload(Payload(payloads(q.source).at(positions[i])), q.qt);
+				willNeed(idxStore().dataAt(types[i].fmPtr()));
+				willNeed(idxStore().dataAt(types[i].pPtr()));
+			}
+			catch (const sserialize::OutOfBoundsException & e) {
+				valid[i] = false;
+			}
+		}
+		for(std::size_t i(0); i < gSize; ++i) {
+			if (valid[i]) {
+				Payload::Type const & t = types[i];
+				result.emplace_back(idxStore().at( t.fmPtr() ), idxStore().at( t.pPtr() ), t.pItemsPtrBegin(), ci, idxStore(), flags());
+			}
+			else {
+				result.emplace_back(ci, idxStore(), flags());
+			}
+		}
+	}
+	return result;
+}
+
 template<typename T_CQR_TYPE>
 T_CQR_TYPE
 OscarSearchSgIndex::cell(uint32_t cellId) const {
-	throw sserialize::UnimplementedFunctionException("OscarSearchSgIndex::cell");
-	return T_CQR_TYPE();
+	if (cellId >= sgInfo().cPixelCount()) {
+		return fullMatchCells<T_CQR_TYPE>(std::vector<uint32_t>());
+	}
+	return fullMatchCells<T_CQR_TYPE>(std::vector<uint32_t>(1, cellId));
 }
 
 template<typename T_CQR_TYPE>
 T_CQR_TYPE
 OscarSearchSgIndex::region(uint32_t regionId) const {
-	throw sserialize::UnimplementedFunctionException("OscarSearchSgIndex::region");
-	return T_CQR_TYPE();
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+	if (!hasRegionCells()) {
+		throw sserialize::UnsupportedFeatureException("OscarSearchSgIndex::region: index has no region cells");
+	}
+    auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	if (!m_regionStoreIds.contains(regionId)) {
+		return T_CQR_TYPE(ci, idxStore(), flags());
+	}
+	Payload::Type t( Payload(m_regionCells.at(m_regionStoreIds.at(regionId))).type(sserialize::StringCompleter::QT_EXACT) );
+	return T_CQR_TYPE(idxStore().at( t.fmPtr() ), idxStore().at( t.pPtr() ), t.pItemsPtrBegin(), ci, idxStore(), flags());
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::regionExclusiveCells(uint32_t regionId) const {
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+	if (!hasRegionExclusiveCells()) {
+		throw sserialize::UnsupportedFeatureException("OscarSearchSgIndex::regionExclusiveCells: index has no region exclusive cells");
+	}
+    auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	if (!m_regionStoreIds.contains(regionId)) {
+		return T_CQR_TYPE(ci, idxStore(), flags());
+	}
+	Payload::Type t( Payload(m_regionExclusiveCells.at(m_regionStoreIds.at(regionId))).type(sserialize::StringCompleter::QT_EXACT) );
+	return T_CQR_TYPE(idxStore().at( t.fmPtr() ), idxStore().at( t.pPtr() ), t.pItemsPtrBegin(), ci, idxStore(), flags());
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::cells(std::vector<uint32_t> cellIds) const {
+	std::sort(cellIds.begin(), cellIds.end());
+	cellIds.erase(std::unique(cellIds.begin(), cellIds.end()), cellIds.end());
+	cellIds.erase(std::lower_bound(cellIds.begin(), cellIds.end(), sgInfo().cPixelCount()), cellIds.end());
+	return fullMatchCells<T_CQR_TYPE>(cellIds);
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::item(uint32_t itemId) const {
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+    auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	std::vector<uint32_t> cellIds = itemCellIds(itemId);
+	std::vector<sserialize::ItemIndex> pmItems(cellIds.size(), sserialize::ItemIndex(std::vector<uint32_t>(1, itemId)));
+	return T_CQR_TYPE(sserialize::ItemIndex(), sserialize::ItemIndex(std::move(cellIds)), pmItems.cbegin(), ci, idxStore(), flags());
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::relevantElement(T_CQR_TYPE const & cqr) const {
+	uint32_t itemId = minItemId(cqr);
+	if (itemId == std::numeric_limits<uint32_t>::max()) {
+		return fullMatchCells<T_CQR_TYPE>(std::vector<uint32_t>());
+	}
+	if (isRegion(itemId)) {
+		return region<T_CQR_TYPE>(itemId).allToFull();
+	}
+	return fullMatchCells<T_CQR_TYPE>(itemCellIds(itemId));
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::in(T_CQR_TYPE const & cqr) const {
+	return regions<T_CQR_TYPE>(regionStoreIds(cqr));
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::regions(std::vector<uint32_t> const & storeIds) const {
+	std::vector<T_CQR_TYPE> regions;
+	for(uint32_t storeId : storeIds) {
+		regions.emplace_back(region<T_CQR_TYPE>(storeId));
+	}
+	if (!regions.size()) {
+		return fullMatchCells<T_CQR_TYPE>(std::vector<uint32_t>());
+	}
+	//pairwise to keep the operands of similar size
+	while (regions.size() > 1) {
+		std::vector<T_CQR_TYPE> tmp;
+		for(std::size_t i(0), s(regions.size()); i < s; i += 2) {
+			if (i+1 < s) {
+				tmp.emplace_back(regions[i] + regions[i+1]);
+			}
+			else {
+				tmp.emplace_back(std::move(regions[i]));
+			}
+		}
+		regions = std::move(tmp);
+	}
+	return regions.front();
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::rect(sserialize::spatial::GeoRect const & rect, ItemFilter const & refine) const {
+	return cells<T_CQR_TYPE>(hic::SpatialGridCoverer(sg()).cover(rect), refine);
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::polygon(std::vector<sserialize::spatial::GeoPoint> const & points, ItemFilter const & refine) const {
+	return cells<T_CQR_TYPE>(hic::SpatialGridCoverer(sg()).polygon(points, sg().defaultLevel()), refine);
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::path(double radius, std::vector<sserialize::spatial::GeoPoint> const & points, ItemFilter const & refine) const {
+	return cells<T_CQR_TYPE>(hic::SpatialGridCoverer(sg()).path(radius, points, sg().defaultLevel()), refine);
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::cells(hic::SpatialGridCovering const & covering, ItemFilter const & refine) const {
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+    auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	std::vector<uint32_t> fmCellIds = cellIds(covering.interior);
+	std::vector<uint32_t> pmCellIds = cellIds(covering.boundary);
+	if (refine) {
+		std::vector<uint32_t> refinedCellIds;
+		std::vector<sserialize::ItemIndex> refinedItems;
+		for(uint32_t cellId : pmCellIds) {
+			sserialize::ItemIndex idx = idxStore().at(sgInfo().itemIndexId(cellId));
+			std::vector<uint32_t> items;
+			for(auto it(idx.cbegin()), end(idx.cend()); it != end; ++it) {
+				if (refine(*it)) {
+					items.push_back(*it);
+				}
+			}
+			if (items.size()) {
+				refinedCellIds.push_back(cellId);
+				refinedItems.emplace_back(std::move(items));
+			}
+		}
+		return T_CQR_TYPE(sserialize::ItemIndex(std::move(fmCellIds)), sserialize::ItemIndex(std::move(refinedCellIds)), refinedItems.cbegin(), ci, idxStore(), flags());
+	}
+	std::vector<uint32_t> pmItems;
+	pmItems.reserve(pmCellIds.size());
+	for(uint32_t cellId : pmCellIds) {
+		pmItems.push_back(sgInfo().itemIndexId(cellId));
+	}
+	return T_CQR_TYPE(sserialize::ItemIndex(std::move(fmCellIds)), sserialize::ItemIndex(std::move(pmCellIds)), pmItems.cbegin(), ci, idxStore(), flags());
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::near(T_CQR_TYPE const & cqr, double distance, bool withSource) const {
+	return fullMatchCells<T_CQR_TYPE>(nearCellIds(cellIds(cqr), distance, withSource));
+}
+
+template<typename T_CQR_TYPE>
+T_CQR_TYPE
+OscarSearchSgIndex::fullMatchCells(std::vector<uint32_t> const & cellIds) const {
+	using CellInfo = hic::Static::detail::OscarSearchSgIndexCellInfo;
+    auto ci = CellInfo::makeRc( sserialize::RCPtrWrapper<Self>(const_cast<OscarSearchSgIndex*>(this)) );
+	std::vector<uint32_t> pmItems;
+	return T_CQR_TYPE(sserialize::ItemIndex(cellIds), sserialize::ItemIndex(), pmItems.cbegin(), ci, idxStore(), flags());
 }
 
 }//end namespace hic::Static
@@ -4,6 +4,9 @@
 
 #include <h3api.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace hic {
 
 void H3SpatialGrid::registerWithSpatialGridRegistry() {
@@ -127,7 +130,8 @@ H3SpatialGrid::area(PixelId pixel) const {
 		throw sserialize::spatial::dgg::exceptions::InvalidPixelId("H3SpatialGrid: root pixel has no area");
 		return 0;
 	}
-	return h3_hexAreaKm2(level(pixel));
+	//level of the grid is the h3 resolution + 1
+	return h3_hexAreaKm2(level(pixel)-1);
 }
 
 sserialize::spatial::GeoRect
@@ -138,11 +142,38 @@ H3SpatialGrid::bbox(PixelId pixel) const {
 	}
 	GeoBoundary gb;
 	h3_h3ToGeoBoundary(pixel, &gb);
-	sserialize::spatial::GeoRect rect;
+	//h3 returns the vertices in radians
+	double minLat = std::numeric_limits<double>::max();
+	double maxLat = std::numeric_limits<double>::lowest();
+	double minLon = std::numeric_limits<double>::max();
+	double maxLon = std::numeric_limits<double>::lowest();
 	for(int i(0); i < gb.numVerts; ++i) {
-		rect.enlarge(h3_degsToRads(gb.verts[i].lat), h3_degsToRads(gb.verts[i].lon));
+		double lat = h3_radsToDegs(gb.verts[i].lat);
+		double lon = h3_radsToDegs(gb.verts[i].lon);
+		minLat = std::min(minLat, lat);
+		maxLat = std::max(maxLat, lat);
+		minLon = std::min(minLon, lon);
+		maxLon = std::max(maxLon, lon);
+	}
+	return sserialize::spatial::GeoRect(minLat, maxLat, minLon, maxLon);
+}
+
+std::vector<H3SpatialGrid::PixelId>
+H3SpatialGrid::neighbours(PixelId pixel) const {
+	std::vector<PixelId> result;
+	if (pixel == RootPixelId) {
+		return result;
+	}
+	std::vector<H3Index> ring(h3_maxKringSize(1), 0);
+	h3_kRing(pixel, 1, ring.data());
+	for(H3Index x : ring) {
+		//kRing leaves unused slots zero
+		if (x && x != pixel) {
+			result.push_back(x);
+		}
 	}
-	return rect;
+	std::sort(result.begin(), result.end());
+	return result;
 }
 
 H3SpatialGrid::H3SpatialGrid(uint32_t defLevel) :
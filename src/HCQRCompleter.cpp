@@ -0,0 +1,93 @@
+#include <hic/HCQRCompleter.h>
+#include <sserialize/utility/exceptions.h>
+
+#include <fstream>
+
+namespace hic {
+
+HCQRCompleter::HCQRCompleter(HCQRIndexPtr const & index, SpatialOpsPtr const & spatialOps) :
+m_d(index),
+m_so(spatialOps)
+{}
+
+HCQRCompleter::~HCQRCompleter() {}
+
+sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR>
+HCQRCompleter::complete(std::string const & str, uint32_t threadCount, hic::Deadline const & deadline, uint32_t maxLevel) {
+	if (m_maxQueryLogSize) {
+		std::lock_guard<std::mutex> lck(m_queryLogLock);
+		if (m_queryLog.size() < m_maxQueryLogSize && m_loggedQueries.insert(str).second) {
+			m_queryLog.push_back(str);
+		}
+	}
+	HcqrOpTree opTree(m_d, m_so);
+	opTree.parse(str);
+	opTree.deadline(deadline);
+	opTree.maxLevel(maxLevel);
+	return opTree.calc(threadCount);
+}
+
+sserialize::ItemIndex
+HCQRCompleter::items(sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> const & hcqr, uint32_t threadCount) const {
+	return HcqrOpTree::items(hcqr, m_so, threadCount);
+}
+
+std::vector<hic::PixelCount>
+HCQRCompleter::heatmap(sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::HCQR> const & hcqr, uint32_t level) const {
+	return HcqrOpTree::heatmap(hcqr, m_so, level);
+}
+
+void
+HCQRCompleter::recordQueries(std::size_t maxSize) {
+	std::lock_guard<std::mutex> lck(m_queryLogLock);
+	m_maxQueryLogSize = maxSize;
+}
+
+std::vector<std::string>
+HCQRCompleter::queryLog() const {
+	std::lock_guard<std::mutex> lck(m_queryLogLock);
+	return m_queryLog;
+}
+
+void
+HCQRCompleter::dumpQueryLog(std::string const & fileName, std::vector<std::string> const & queries) {
+	std::ofstream out(fileName);
+	if (!out.is_open()) {
+		throw sserialize::IOException("HCQRCompleter: could not open " + fileName);
+	}
+	for(std::string const & str : queries) {
+		out << str << '\n';
+	}
+	if (!out.good()) {
+		throw sserialize::IOException("HCQRCompleter: could not write " + fileName);
+	}
+}
+
+HCQRCompleter::WarmUpStats
+HCQRCompleter::warmUp(std::string const & fileName, uint32_t threadCount) {
+	std::ifstream in(fileName);
+	if (!in.is_open()) {
+		throw sserialize::IOException("HCQRCompleter: could not open " + fileName);
+	}
+	WarmUpStats result;
+	std::string str;
+	while (std::getline(in, str)) {
+		if (str.empty()) {
+			continue;
+		}
+		try {
+			complete(str, threadCount);
+			++result.replayed;
+		}
+		catch (sserialize::UnsupportedFeatureException const &) {
+			//the log may contain queries of completers with other spatial operations
+			++result.unsupported;
+		}
+		catch (std::exception const & e) {
+			result.errors.push_back(str + ": " + e.what());
+		}
+	}
+	return result;
+}
+
+}//end namespace hic
@@ -1,24 +1,177 @@
 #include <hic/HcqrOpTree.h>
+#include <hic/SpatialGridCovering.h>
+#include <sserialize/mt/ThreadPool.h>
+
+#include <atomic>
 
 namespace hic {
 	
 	
-HcqrOpTree::HcqrOpTree(SearchIndex const & si) :
-m_d(si)
+HcqrOpTree::HcqrOpTree(SearchIndex const & si, SpatialOps const & so) :
+m_d(si),
+m_so(so)
 {}
 
 HcqrOpTree::~HcqrOpTree() {}
 
 HcqrOpTree::HCQRPtr
-HcqrOpTree::calc() {
-	return Calc(m_d).calc(root());
+HcqrOpTree::calc(uint32_t threadCount) {
+	return Calc(m_d, m_so, threadCount, m_deadline, m_maxLevel, root()).calc(root());
+}
+
+sserialize::ItemIndex
+HcqrOpTree::items(HCQRPtr const & hcqr, SpatialOps const & so, uint32_t threadCount) {
+	if (!hcqr) {
+		return sserialize::ItemIndex();
+	}
+	if (!so || threadCount < 2 || hcqr->numberOfNodes() < ParallelHcqrNodeThreshold) {
+		return hcqr->items();
+	}
+	//Items may span multiple root subtrees, hence the parts are united and not concatenated
+	auto const & roots = so->rootRegions();
+	std::vector<sserialize::ItemIndex> parts(roots.size());
+	std::atomic<std::size_t> next{0};
+	sserialize::ThreadPool::execute([&]() {
+		while (true) {
+			std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+			if (i >= roots.size()) {
+				return;
+			}
+			HCQRPtr part = *hcqr / *roots[i];
+			if (part) {
+				parts[i] = part->items();
+			}
+		}
+	}, threadCount, sserialize::ThreadPool::CopyTaskTag());
+	return sserialize::ItemIndex::unite(parts);
+}
+
+std::vector<hic::PixelCount>
+HcqrOpTree::heatmap(HCQRPtr const & hcqr, SpatialOps const & so, uint32_t level) {
+	if (!so) {
+		throw sserialize::UnsupportedFeatureException("HcqrOpTree: heatmap");
+	}
+	if (!hcqr) {
+		return std::vector<hic::PixelCount>();
+	}
+	return so->heatmap(hcqr, level);
+}
+
+HcqrOpTree::HCQRPtr
+HcqrOpTree::apply(char op, HCQRPtr const & a, HCQRPtr const & b) {
+	switch (op) {
+	case '+':
+		if (a && b) {
+			return *a + *b;
+		}
+		return a ? a : b;
+	case '/':
+	case ' ':
+		if (a && b) {
+			return *a / *b;
+		}
+		return HCQRPtr();
+	case '-':
+		if (a && b) {
+			return *a - *b;
+		}
+		return a;
+	case '^':
+		//HCQR has no symmetric difference of its own
+		if (a && b) {
+			HCQRPtr ab = *a - *b;
+			HCQRPtr ba = *b - *a;
+			return apply('+', ab, ba);
+		}
+		return a ? a : b;
+	default:
+		return HCQRPtr();
+	};
+}
+
+HcqrOpTree::HCQRPtr
+HcqrOpTree::Calc::fanOut(char op, HCQRPtr const & a, HCQRPtr const & b) {
+	std::vector<hic::detail::ThreadBudget::Future<HCQRPtr>> tasks;
+	for(HCQRPtr const & root : m_so->rootRegions()) {
+		tasks.emplace_back(m_tb.async(true, [&root, &a, &b, op]() {
+			return HcqrOpTree::apply(op, *a / *root, *b / *root);
+		}));
+	}
+	std::vector<HCQRPtr> parts;
+	for(auto & x : tasks) {
+		HCQRPtr part = x.get();
+		if (part && part->numberOfNodes()) {
+			parts.emplace_back(std::move(part));
+		}
+	}
+	m_deadline.check("HcqrOpTree");
+	return unite(std::move(parts));
+}
+
+HcqrOpTree::HCQRPtr
+HcqrOpTree::Calc::unite(std::vector<HCQRPtr> results) {
+	while (results.size() > 1) {
+		std::vector<hic::detail::ThreadBudget::Future<HCQRPtr>> tasks;
+		for(std::size_t i(0), s(results.size()); i+1 < s; i += 2) {
+			HCQRPtr const & a = results[i];
+			HCQRPtr const & b = results[i+1];
+			tasks.emplace_back(m_tb.async(true, [&a, &b]() {
+				return *a + *b;
+			}));
+		}
+		std::vector<HCQRPtr> next;
+		for(auto & x : tasks) {
+			next.emplace_back(x.get());
+		}
+		if (results.size() % 2) {
+			next.emplace_back(std::move(results.back()));
+		}
+		results = std::move(next);
+	}
+	return results.size() ? results.front() : HCQRPtr();
+}
+
+std::size_t
+HcqrOpTree::Calc::leafCost(const Node * node) {
+	switch (node->subType) {
+	case Node::CELL:
+	case Node::POINT:
+	case Node::ITEM:
+		return 0;
+	default:
+		return 1;
+	};
+}
+
+std::size_t
+HcqrOpTree::Calc::cost(const Node * node) {
+	if (!node) {
+		return 0;
+	}
+	std::size_t result = (node->baseType == Node::LEAF ? leafCost(node) : 0);
+	for(const Node * child : node->children) {
+		result += cost(child);
+	}
+	m_cost[node] = result;
+	return result;
 }
 
 HcqrOpTree::HCQRPtr
-HcqrOpTree::Calc::Calc::calc(const Node * node) {
+HcqrOpTree::Calc::calc(const Node * node) {
     if (!node) {
         return HCQRPtr();
     }
+	m_deadline.check("HcqrOpTree");
+	HCQRPtr result = calcNode(node);
+	//Operands of set operations are already collapsed and so is their result
+	if (result && m_maxLevel != NoMaxLevel && node->baseType != Node::BINARY_OP) {
+		result = result->compactified(m_maxLevel);
+	}
+	return result;
+}
+
+HcqrOpTree::HCQRPtr
+HcqrOpTree::Calc::calcNode(const Node * node) {
 	switch (node->baseType) {
 	case Node::LEAF:
 		switch (node->subType) {
@@ -46,21 +199,42 @@ HcqrOpTree::Calc::Calc::calc(const Node * node) {
 		case Node::REGION:
 			return m_d->region(std::atoi(node->value.c_str()));
 		case Node::REGION_EXCLUSIVE_CELLS:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: region exclusive cells");
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: region exclusive cells");
+			}
+			return m_so->regionExclusiveCells(std::atoi(node->value.c_str()));
 		case Node::CELL:
 			return m_d->cell(std::atoi(node->value.c_str()));
 		case Node::CELLS:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: cells");
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: cells");
+			}
+			return m_so->cells(hic::SpatialGridCoverer::parseCellIds(node->value));
 		case Node::RECT:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: rectangle");
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: rectangle");
+			}
+			return m_so->rect(sserialize::spatial::GeoRect(node->value, true));
 		case Node::POLYGON:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: polygon");
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: polygon");
+			}
+			return m_so->polygon(hic::SpatialGridCoverer::parsePolygon(node->value));
 		case Node::PATH:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: path");
+		{
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: path");
+			}
+			auto path = hic::SpatialGridCoverer::parsePath(node->value);
+			return m_so->path(path.first, path.second);
+		}
 		case Node::POINT:
 			throw sserialize::UnsupportedFeatureException("HcqrOpTree: point");
 		case Node::ITEM:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: item");
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: item");
+			}
+			return m_so->item(std::atoi(node->value.c_str()));
 		default:
 			break;
 		};
@@ -78,18 +252,55 @@ HcqrOpTree::Calc::Calc::calc(const Node * node) {
                 }
             }
 		case Node::CELL_DILATION_OP:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: cell dilation");
+		{
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: cell dilation");
+			}
+			auto child = calc(node->children.at(0));
+			if (!child) {
+				return child;
+			}
+			auto dilation = m_so->near(child, std::atof(node->value.c_str()), false);
+			return dilation ? *child + *dilation : child;
+		}
 		case Node::REGION_DILATION_BY_ITEM_COVERAGE_OP:
 		case Node::REGION_DILATION_BY_CELL_COVERAGE_OP:
 			throw sserialize::UnsupportedFeatureException("HcqrOpTree: region dilation");
 		case Node::COMPASS_OP:
 			throw sserialize::UnsupportedFeatureException("HcqrOpTree: compass");
 		case Node::IN_OP:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: in");
+		{
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: in");
+			}
+			auto child = calc(node->children.at(0));
+			if (!child) {
+				return child;
+			}
+			return m_so->in(child);
+		}
 		case Node::NEAR_OP:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: near");
+		{
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: near");
+			}
+			auto child = calc(node->children.at(0));
+			if (!child) {
+				return child;
+			}
+			return m_so->near(child, std::atof(node->value.c_str()), true);
+		}
 		case Node::RELEVANT_ELEMENT_OP:
-			throw sserialize::UnsupportedFeatureException("HcqrOpTree: relevant item");
+		{
+			if (!m_so) {
+				throw sserialize::UnsupportedFeatureException("HcqrOpTree: relevant item");
+			}
+			auto child = calc(node->children.at(0));
+			if (!child) {
+				return child;
+			}
+			return m_so->relevantElement(child);
+		}
 		case Node::QUERY_EXCLUSIVE_CELLS:
 			throw sserialize::UnsupportedFeatureException("HcqrOpTree: query exclusive cells");
 		default:
@@ -100,41 +311,29 @@ HcqrOpTree::Calc::Calc::calc(const Node * node) {
 		switch(node->subType) {
 		case Node::SET_OP:
         {
-            auto firstOperand = calc(node->children.front());
-            auto secondOperand = calc(node->children.back());
+			const Node * firstChild = node->children.front();
+			const Node * secondChild = node->children.back();
+			bool worthIt = m_tb.parallel() && firstChild && secondChild &&
+				m_cost.at(firstChild) >= ParallelLeafCostThreshold && m_cost.at(secondChild) >= ParallelLeafCostThreshold;
+			auto secondTask = m_tb.async(worthIt, [this, secondChild]() {
+				return calc(secondChild);
+			});
+            auto firstOperand = calc(firstChild);
+            auto secondOperand = secondTask.get();
+			m_deadline.check("HcqrOpTree");
 			switch (node->value.at(0)) {
 			case '+':
-            {
-				if (firstOperand && secondOperand) {
-                    return *firstOperand + *secondOperand;
-                }
-                else if (firstOperand) {
-                    return firstOperand;
-                }
-                else if (secondOperand) {
-                    return secondOperand;
-                }
-                else {
-                    return HCQRPtr();
-                }
-            }
             case '/':
 			case ' ':
-				if (firstOperand && secondOperand) {
-                    return *firstOperand / *secondOperand;
-                }
-                else {
-                    return HCQRPtr();
-                }
 			case '-':
-                if (firstOperand && secondOperand) {
-                    return *firstOperand - *secondOperand;
-                }
-                else {
-                    return firstOperand;
-                }
 			case '^':
-				throw sserialize::UnsupportedFeatureException("HcqrOpTree: symmetric difference");
+				if (m_so && m_tb.parallel() && firstOperand && secondOperand &&
+					firstOperand->numberOfNodes() >= ParallelHcqrNodeThreshold &&
+					secondOperand->numberOfNodes() >= ParallelHcqrNodeThreshold)
+				{
+					return fanOut(node->value.at(0), firstOperand, secondOperand);
+				}
+				return HcqrOpTree::apply(node->value.at(0), firstOperand, secondOperand);
 			default:
 				return HCQRPtr();
 			};
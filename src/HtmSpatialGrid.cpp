@@ -5,6 +5,10 @@
 #include <lsst/sphgeom/LonLat.h>
 #include <lsst/sphgeom/Circle.h>
 #include <lsst/sphgeom/Box.h>
+#include <lsst/sphgeom/ConvexPolygon.h>
+
+#include <cmath>
+#include <algorithm>
 
 namespace hic {
 	
@@ -138,7 +142,11 @@ HtmSpatialGrid::area(PixelId pixel) const {
 		throw sserialize::spatial::dgg::exceptions::InvalidPixelId("HtmSpatialGrid: root pixel has no area");
 		return 0;
 	}
-	return (12700/2)*(12700/2) * HtmPixelization::triangle(pixel).getBoundingCircle().getArea();
+	//spherical excess of the triangle, the bounding circle overestimates the area
+	auto const & v = HtmPixelization::triangle(pixel).getVertices();
+	double triple = std::abs(v[0].dot(v[1].cross(v[2])));
+	double excess = 2*std::atan2(triple, 1 + v[0].dot(v[1]) + v[1].dot(v[2]) + v[2].dot(v[0]));
+	return (12700/2)*(12700/2) * excess;
 }
 
 
@@ -154,6 +162,36 @@ HtmSpatialGrid::bbox(PixelId pixel) const {
 	return sserialize::spatial::GeoRect(lat.getA().asDegrees(), lat.getB().asDegrees(), lon.getA().asDegrees(), lon.getB().asDegrees());
 }
 
+std::vector<HtmSpatialGrid::PixelId>
+HtmSpatialGrid::neighbours(PixelId pixel) const {
+	std::vector<PixelId> result;
+	if (pixel == RootPixelId) {
+		return result;
+	}
+	auto lvl = level(pixel);
+	//Every neighbour shares at least one vertex with the trixel.
+	//Hence sampling small circles around the vertices finds all of them.
+	//At most 6 trixels meet at a vertex, each spanning an angle of at least 60 degrees
+	constexpr int SampleCount = 12;
+	std::vector<lsst::sphgeom::UnitVector3d> const & verts = HtmPixelization::triangle(pixel).getVertices();
+	double r = (verts.at(0) - verts.at(1)).getNorm() * 0.05;
+	for(lsst::sphgeom::UnitVector3d const & v : verts) {
+		lsst::sphgeom::UnitVector3d u = lsst::sphgeom::UnitVector3d::orthogonalTo(v);
+		lsst::sphgeom::Vector3d w = v.cross(u);
+		for(int i(0); i < SampleCount; ++i) {
+			double a = 2*M_PI*i/SampleCount;
+			lsst::sphgeom::UnitVector3d p(v + (u*std::cos(a) + w*std::sin(a))*r);
+			PixelId n = m_hps.at(lvl-1).index(p);
+			if (n != pixel) {
+				result.push_back(n);
+			}
+		}
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
 HtmSpatialGrid::HtmSpatialGrid(uint32_t maxLevel) {
 	m_hps.reserve(maxLevel+1);
 	for(uint32_t i(0); i <= maxLevel; ++i) {
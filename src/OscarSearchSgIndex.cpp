@@ -104,17 +104,27 @@ OscarSearchSgIndex::WorkerBase::operator()() {
 
 void
 OscarSearchSgIndex::WorkerBase::process(uint32_t strId, sserialize::StringCompleter::QuerryType qt) {
-	CellTextCompleter::Payload payload = state().trie.at(strId);
-	if ((payload.types() & qt) == sserialize::StringCompleter::QT_NONE) {
-		return;
+	CellTextCompleter::Payload::Type typeData;
+	sserialize::ItemIndex fmCells;
+	if (state().itemMatchType == IM_REGION_CELLS) { //strId is the ghId of a region
+		fmCells = state().idxStore.at( state().gh.regionCellIdxPtr(strId) );
 	}
-	CellTextCompleter::Payload::Type typeData = payload.type(qt);
-	if (!typeData.valid()) {
-		std::cerr << std::endl << "Invalid trie payload data for string " << strId << " = " << state().trie.strAt(strId) << std::endl;
+	else if (state().itemMatchType == IM_REGION_EXCLUSIVE_CELLS) {
+		fmCells = state().idxStore.at( state().gh.regionExclusiveCellIdxPtr(strId) );
+	}
+	else {
+		CellTextCompleter::Payload payload = state().trie.at(strId);
+		if ((payload.types() & qt) == sserialize::StringCompleter::QT_NONE) {
+			return;
+		}
+		typeData = payload.type(qt);
+		if (!typeData.valid()) {
+			std::cerr << std::endl << "Invalid trie payload data for string " << strId << " = " << state().trie.strAt(strId) << std::endl;
+		}
+		fmCells = state().idxStore.at( typeData.fmPtr() );
 	}
-	sserialize::ItemIndex fmCells = state().idxStore.at( typeData.fmPtr() );
 	
-	if (state().itemMatchType & IM_REGIONS) {
+	if (state().itemMatchType & (IM_REGIONS | IM_REGION_CELLS | IM_REGION_EXCLUSIVE_CELLS)) {
 		for(auto cellId : fmCells) {
 			if (cellId >= state().that->m_ohi->cellTrixelMap().size()) {
 				std::cerr << std::endl << "Invalid cellId for string with id " << strId << " = " << state().trie.strAt(strId) << std::endl;
@@ -195,9 +205,9 @@ OscarSearchSgIndex::WorkerBase::flush(uint32_t strId, sserialize::StringComplete
 	}
 	d.fmTrixels = state().that->m_idxFactory.addIndex(fmTrixels);
 	d.pmTrixels = state().that->m_idxFactory.addIndex(pmTrixels);
-	SSERIALIZE_EXPENSIVE_ASSERT_EQUAL(strId, state().trie.find(state().trie.strAt(strId), qt & (sserialize::StringCompleter::QT_PREFIX | sserialize::StringCompleter::QT_SUBSTRING)));
 	#ifdef SSERIALIZE_EXPENSIVE_ASSERT_ENABLED
-	{
+	if (!(state().itemMatchType & (IM_REGION_CELLS | IM_REGION_EXCLUSIVE_CELLS))) {
+		SSERIALIZE_EXPENSIVE_ASSERT_EQUAL(strId, state().trie.find(state().trie.strAt(strId), qt & (sserialize::StringCompleter::QT_PREFIX | sserialize::StringCompleter::QT_SUBSTRING)));
 		sserialize::ItemIndex realItems;
 		if (state().itemMatchType == IM_ITEMS) {
 			realItems = state().that->ctc().items(state().trie.strAt(strId), qt).flaten();
@@ -412,7 +422,7 @@ void OscarSearchSgIndex::create(uint32_t threadCount, FlusherType ft) {
 
 
 sserialize::UByteArrayAdapter &
-OscarSearchSgIndex::create(sserialize::UByteArrayAdapter & dest, uint32_t threadCount) {
+OscarSearchSgIndex::create(sserialize::UByteArrayAdapter & dest, uint32_t threadCount, int flags) {
 	using MetaData = sserialize::spatial::dgg::Static::ssinfo::SpatialGridInfo::MetaData;
 	
 	if (!threadCount) {
@@ -424,7 +434,7 @@ OscarSearchSgIndex::create(sserialize::UByteArrayAdapter & dest, uint32_t thread
 	auto ctc = this->ctc();
 	auto trie = this->trie();
 	//OscarSearchSgIndex
-	dest.putUint8(2); //version
+	dest.putUint8(4); //version
 	dest.putUint8(ctc.getSupportedQuerries());
 	
 	//HtmInfo
@@ -486,9 +496,86 @@ OscarSearchSgIndex::create(sserialize::UByteArrayAdapter & dest, uint32_t thread
 		
 		sstate.ac.flush();
 	}
+	
+	//Region cells: the trixels covered by each region of the GeoHierarchy
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> storeId2GhId;
+		for(uint32_t ghId(0), s(state.gh.regionSize()); ghId < s; ++ghId) {
+			storeId2GhId.emplace_back(state.gh.ghIdToStoreId(ghId), ghId);
+		}
+		std::sort(storeId2GhId.begin(), storeId2GhId.end());
+		sserialize::Static::Map<uint32_t, uint32_t>::create(storeId2GhId.begin(), storeId2GhId.end(), dest);
+	}
+	//Processes the (exclusive) cells of every region like a region string match
+	auto processRegions = [&](ItemMatchType itemMatchType, char const * message) {
+		state.strId = 0;
+		state.strCount = state.gh.regionSize();
+		state.queryTypes = {sserialize::StringCompleter::QT_EXACT};
+		state.itemMatchType = itemMatchType;
+		SerializationState sstate(dest);
+		state.pinfo.begin(state.strCount, message);
+		if (threadCount == 1) {
+			SerializationFlusher(&sstate, &state, &cfg)();
+		}
+		else {
+			sserialize::ThreadPool::execute(SerializationFlusher(&sstate, &state, &cfg), threadCount, sserialize::ThreadPool::CopyTaskTag());
+		}
+		state.pinfo.end();
+		SSERIALIZE_CHEAP_ASSERT_EQUAL(0, sstate.queuedEntries.size());
+		
+		sstate.ac.flush();
+	};
+	processRegions(IM_REGION_CELLS, "OscarSearchSgIndex: processing regions");
+	
+	dest.putUint8(flags);
+	if (flags & CF_ITEM_TRIXELS) {
+		std::cout << "Serializing item trixels..." << std::flush;
+		serializeItemTrixels(dest);
+		std::cout << "done" << std::endl;
+	}
+	if (flags & CF_REGION_EXCLUSIVE_TRIXELS) {
+		processRegions(IM_REGION_EXCLUSIVE_CELLS, "OscarSearchSgIndex: processing region exclusive cells");
+	}
 	return dest;
 }
 
+void
+OscarSearchSgIndex::serializeItemTrixels(sserialize::UByteArrayAdapter & dest) const {
+	constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+	std::size_t itemCount = m_cmp->store().size();
+	std::vector<uint32_t> begin(itemCount+1, 0);
+	std::vector<uint32_t> last(itemCount, npos);
+	//trixel ids are assigned in the iteration order of trixelData, hence they are ascending for each item.
+	//An item may be part of multiple cells of the same trixel which are visited consecutively
+	auto forEach = [&](auto && fn) {
+		std::fill(last.begin(), last.end(), npos);
+		for(auto const & x : m_ohi->trixelData()) {
+			TrixelId trixelId = m_trixelIdMap.trixelId(x.first);
+			for(auto const & cellItems : x.second) {
+				for(ItemId itemId : cellItems.second) {
+					if (last.at(itemId) != trixelId) {
+						last[itemId] = trixelId;
+						fn(itemId, trixelId);
+					}
+				}
+			}
+		}
+	};
+	forEach([&begin](ItemId itemId, TrixelId) {
+		begin[itemId+1] += 1;
+	});
+	for(std::size_t i(1), s(begin.size()); i < s; ++i) {
+		begin[i] += begin[i-1];
+	}
+	std::vector<uint32_t> trixels(begin.back());
+	std::vector<uint32_t> pos(begin.begin(), begin.end()-1);
+	forEach([&trixels, &pos](ItemId itemId, TrixelId trixelId) {
+		trixels[pos[itemId]++] = trixelId;
+	});
+	sserialize::BoundedCompactUintArray::create(begin, dest);
+	sserialize::BoundedCompactUintArray::create(trixels, dest);
+}
+
 OscarSearchSgIndex::TrieType
 OscarSearchSgIndex::trie() const {
 	auto triePtr = ctc().trie().as<CellTextCompleter::FlatTrieType>();
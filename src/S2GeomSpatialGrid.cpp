@@ -7,6 +7,8 @@
 #include <s2/s2latlng.h>
 #include <s2/s2latlng_rect.h>
 
+#include <algorithm>
+
 namespace hic {
 	
 void S2GeomSpatialGrid::registerWithSpatialGridRegistry() {
@@ -138,6 +140,23 @@ S2GeomSpatialGrid::bbox(PixelId pixel) const {
 	);
 }
 
+std::vector<S2GeomSpatialGrid::PixelId>
+S2GeomSpatialGrid::neighbours(PixelId pixel) const {
+	std::vector<PixelId> result;
+	if (pixel == RootPixelId) {
+		return result;
+	}
+	S2CellId cellId(pixel);
+	std::vector<S2CellId> tmp;
+	cellId.AppendAllNeighbors(cellId.level(), &tmp);
+	for(S2CellId const & x : tmp) {
+		result.push_back(x.id());
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
 S2GeomSpatialGrid::S2GeomSpatialGrid(uint32_t defLevel) :
 m_defaultLevel(defLevel)
 {}
@@ -0,0 +1,459 @@
+#include <hic/SerializedHcqr.h>
+#include <sserialize/utility/exceptions.h>
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace hic {
+
+//BEGIN set operation policies
+
+struct SerializedHcqr::Union {
+	///Keep subtrees that are only part of the first or second operand
+	static constexpr bool KeepA = true;
+	static constexpr bool KeepB = true;
+	static std::vector<uint32_t> items(std::vector<uint32_t> const & a, std::vector<uint32_t> const & b) {
+		std::vector<uint32_t> result;
+		std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+		return result;
+	}
+};
+
+struct SerializedHcqr::Intersection {
+	static constexpr bool KeepA = false;
+	static constexpr bool KeepB = false;
+	static std::vector<uint32_t> items(std::vector<uint32_t> const & a, std::vector<uint32_t> const & b) {
+		std::vector<uint32_t> result;
+		std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+		return result;
+	}
+};
+
+struct SerializedHcqr::Difference {
+	static constexpr bool KeepA = true;
+	static constexpr bool KeepB = false;
+	static std::vector<uint32_t> items(std::vector<uint32_t> const & a, std::vector<uint32_t> const & b) {
+		std::vector<uint32_t> result;
+		std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+		return result;
+	}
+};
+
+//END set operation policies
+
+//BEGIN Merger
+
+class SerializedHcqr::Merger final {
+public:
+	Merger(Context const & ctx) : m_ctx(ctx) {}
+public:
+	///Merges the nodes na of a and nb of b which have to have the same pixel id and appends the result to dest.
+	///Nothing is appended if the result is empty
+	template<typename T_OP>
+	void merge(sserialize::UByteArrayAdapter const & a, Node const & na, sserialize::UByteArrayAdapter const & b, Node const & nb, sserialize::UByteArrayAdapter & dest) const;
+public:
+	static void copy(sserialize::UByteArrayAdapter const & src, ChildRef const & child, sserialize::UByteArrayAdapter & dest) {
+		dest.put(sserialize::UByteArrayAdapter(src, child.begin, child.end-child.begin));
+	}
+public:
+	///Internal node with a full-match child for every child pixel of pixel containing cells
+	sserialize::UByteArrayAdapter expand(PixelId pixel) const {
+		sserialize::UByteArrayAdapter result(0, sserialize::MM_PROGRAM_MEMORY);
+		std::vector<ChildRef> refs;
+		SizeType begin = beginInternal(pixel, result);
+		for(PixelId child : m_ctx.cells->children(pixel)) {
+			SizeType childBegin = result.tellPutPtr();
+			putFull(child, result);
+			refs.push_back(ChildRef{child, childBegin, result.tellPutPtr()});
+		}
+		endInternal(begin, refs, result);
+		return result;
+	}
+	///Items of the cell pixel
+	std::vector<uint32_t> cellItemIds(PixelId pixel) const {
+		std::vector<uint32_t> result;
+		if (m_ctx.sgInfo->hasSgIndex(pixel)) {
+			sserialize::ItemIndex idx = m_ctx.idxStore.at( m_ctx.sgInfo->itemIndexId(m_ctx.sgInfo->cPixelId(pixel)) );
+			result.assign(idx.cbegin(), idx.cend());
+		}
+		return result;
+	}
+private:
+	Context const & m_ctx;
+};
+
+template<typename T_OP>
+void
+SerializedHcqr::Merger::merge(sserialize::UByteArrayAdapter const & a, Node const & na, sserialize::UByteArrayAdapter const & b, Node const & nb, sserialize::UByteArrayAdapter & dest) const {
+	if (na.type == NT_FULL_MATCH || nb.type == NT_FULL_MATCH) {
+		if (std::is_same<T_OP, Union>::value) {
+			putFull(na.pixelId, dest);
+		}
+		else if (std::is_same<T_OP, Intersection>::value) {
+			Node const & other = (na.type == NT_FULL_MATCH ? nb : na);
+			copy((na.type == NT_FULL_MATCH ? b : a), ChildRef{other.pixelId, other.begin, other.end}, dest);
+		}
+		else if (nb.type == NT_FULL_MATCH) { //difference with everything
+			return;
+		}
+		else if (nb.type == NT_PARTIAL_MATCH) {
+			putPartial(na.pixelId, T_OP::items(cellItemIds(na.pixelId), SerializedHcqr::partialItems(b, nb)), dest);
+		}
+		else { //only parts of the full-match node remain
+			sserialize::UByteArrayAdapter ea = expand(na.pixelId);
+			if (ea.size()) {
+				merge<T_OP>(ea, SerializedHcqr::node(ea, 0), b, nb, dest);
+			}
+		}
+		return;
+	}
+	if (na.type == NT_PARTIAL_MATCH && nb.type == NT_PARTIAL_MATCH) {
+		putPartial(na.pixelId, T_OP::items(SerializedHcqr::partialItems(a, na), SerializedHcqr::partialItems(b, nb)), dest);
+		return;
+	}
+	if (na.type != nb.type) {
+		throw sserialize::TypeMissMatchException("SerializedHcqr: partial-match nodes have to be leaves at the cell level");
+	}
+	//Only children present in both operands are read, the others are copied or skipped by their table entry.
+	//Children are written directly after the header of their parent in dest
+	std::vector<ChildRef> ca = SerializedHcqr::children(a, na);
+	std::vector<ChildRef> cb = SerializedHcqr::children(b, nb);
+	std::vector<ChildRef> refs;
+	SizeType begin = beginInternal(na.pixelId, dest);
+	for(auto ia(ca.begin()), ib(cb.begin()); ia != ca.end() || ib != cb.end();) {
+		bool onlyA = ib == cb.end() || (ia != ca.end() && ia->pixelId < ib->pixelId);
+		bool onlyB = ia == ca.end() || (ib != cb.end() && ib->pixelId < ia->pixelId);
+		PixelId pixel = (onlyB ? ib->pixelId : ia->pixelId);
+		SizeType childBegin = dest.tellPutPtr();
+		if (!onlyA && !onlyB) {
+			merge<T_OP>(a, SerializedHcqr::node(a, ia->begin), b, SerializedHcqr::node(b, ib->begin), dest);
+		}
+		else if (onlyA && T_OP::KeepA) {
+			copy(a, *ia, dest);
+		}
+		else if (onlyB && T_OP::KeepB) {
+			copy(b, *ib, dest);
+		}
+		if (dest.tellPutPtr() != childBegin) {
+			refs.push_back(ChildRef{pixel, childBegin, dest.tellPutPtr()});
+		}
+		if (!onlyB) {
+			++ia;
+		}
+		if (!onlyA) {
+			++ib;
+		}
+	}
+	endInternal(begin, refs, dest);
+}
+
+//END Merger
+
+//BEGIN SerializedHcqr
+
+SerializedHcqr::SerializedHcqr() {}
+
+SerializedHcqr::SerializedHcqr(sserialize::UByteArrayAdapter const & data, ContextPtr const & ctx) :
+m_d(data),
+m_ctx(ctx)
+{}
+
+SerializedHcqr::~SerializedHcqr() {}
+
+SerializedHcqr
+SerializedHcqr::fromCqr(sserialize::CellQueryResult const & cqr, ContextPtr const & ctx) {
+	std::vector<Leaf> leaves;
+	leaves.reserve(cqr.cellCount());
+	for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+		PixelId pixel = ctx->sgInfo->sgIndex(cqr.cellId(i));
+		if (cqr.fullMatch(i)) {
+			leaves.push_back(Leaf{pixel, NT_FULL_MATCH, {}});
+		}
+		else {
+			sserialize::ItemIndex idx = cqr.idx(i);
+			leaves.push_back(Leaf{pixel, NT_PARTIAL_MATCH, std::vector<uint32_t>(idx.cbegin(), idx.cend())});
+		}
+	}
+	return fromLeaves(std::move(leaves), ctx);
+}
+
+SerializedHcqr
+SerializedHcqr::fromCovering(SpatialGridCovering const & covering, ContextPtr const & ctx) {
+	std::vector<Leaf> leaves;
+	for(PixelId pixel : covering.interior) {
+		if (ctx->cells->contains(pixel)) {
+			leaves.push_back(Leaf{pixel, NT_FULL_MATCH, {}});
+		}
+	}
+	for(PixelId pixel : covering.boundary) {
+		if (ctx->sgInfo->hasSgIndex(pixel)) {
+			sserialize::ItemIndex idx = ctx->idxStore.at( ctx->sgInfo->itemIndexId(ctx->sgInfo->cPixelId(pixel)) );
+			leaves.push_back(Leaf{pixel, NT_PARTIAL_MATCH, std::vector<uint32_t>(idx.cbegin(), idx.cend())});
+		}
+	}
+	return fromLeaves(std::move(leaves), ctx);
+}
+
+SerializedHcqr
+SerializedHcqr::fromLeaves(std::vector<Leaf> leaves, ContextPtr const & ctx) {
+	SpatialGrid const & sg = *ctx->sg;
+	//path from the root to the pixel of each leaf
+	std::vector<std::pair<std::vector<PixelId>, std::size_t>> paths;
+	paths.reserve(leaves.size());
+	for(std::size_t i(0), s(leaves.size()); i < s; ++i) {
+		std::vector<PixelId> path(1, leaves[i].pixelId);
+		while (path.back() != sg.rootPixelId()) {
+			path.push_back(sg.parent(path.back()));
+		}
+		std::reverse(path.begin(), path.end());
+		paths.emplace_back(std::move(path), i);
+	}
+	std::sort(paths.begin(), paths.end());
+
+	auto build = [&leaves, &paths](auto const & self, std::size_t begin, std::size_t end, std::size_t depth, sserialize::UByteArrayAdapter & dest) -> void {
+		PixelId pixel = paths[begin].first.at(depth);
+		if (depth+1 == paths[begin].first.size()) {
+			Leaf const & leaf = leaves[paths[begin].second];
+			if (leaf.type == NT_FULL_MATCH) {
+				putFull(pixel, dest);
+			}
+			else {
+				putPartial(pixel, leaf.items, dest);
+			}
+			return;
+		}
+		std::vector<ChildRef> refs;
+		SizeType nodeBegin = beginInternal(pixel, dest);
+		for(std::size_t cBegin(begin); cBegin < end;) {
+			std::size_t cEnd = cBegin+1;
+			for(; cEnd < end && paths[cEnd].first.at(depth+1) == paths[cBegin].first.at(depth+1); ++cEnd) {}
+			SizeType childBegin = dest.tellPutPtr();
+			self(self, cBegin, cEnd, depth+1, dest);
+			if (dest.tellPutPtr() != childBegin) {
+				refs.push_back(ChildRef{paths[cBegin].first.at(depth+1), childBegin, dest.tellPutPtr()});
+			}
+			cBegin = cEnd;
+		}
+		endInternal(nodeBegin, refs, dest);
+	};
+
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	if (paths.size()) {
+		build(build, 0, paths.size(), 0, data);
+	}
+	return SerializedHcqr(data, ctx);
+}
+
+SerializedHcqr
+SerializedHcqr::operator+(SerializedHcqr const & other) const {
+	if (empty()) {
+		return other;
+	}
+	if (other.empty()) {
+		return *this;
+	}
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	Merger(*m_ctx).merge<Union>(m_d, node(m_d, 0), other.m_d, node(other.m_d, 0), data);
+	return SerializedHcqr(data, m_ctx);
+}
+
+SerializedHcqr
+SerializedHcqr::operator/(SerializedHcqr const & other) const {
+	if (empty() || other.empty()) {
+		return SerializedHcqr(sserialize::UByteArrayAdapter(0, sserialize::MM_PROGRAM_MEMORY), m_ctx);
+	}
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	Merger(*m_ctx).merge<Intersection>(m_d, node(m_d, 0), other.m_d, node(other.m_d, 0), data);
+	return SerializedHcqr(data, m_ctx);
+}
+
+SerializedHcqr
+SerializedHcqr::operator-(SerializedHcqr const & other) const {
+	if (empty() || other.empty()) {
+		return *this;
+	}
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	Merger(*m_ctx).merge<Difference>(m_d, node(m_d, 0), other.m_d, node(other.m_d, 0), data);
+	return SerializedHcqr(data, m_ctx);
+}
+
+std::size_t
+SerializedHcqr::numberOfNodes() const {
+	std::size_t result = 0;
+	std::vector<SizeType> stack;
+	if (!empty()) {
+		stack.push_back(0);
+	}
+	while (stack.size()) {
+		Node n = node(m_d, stack.back());
+		stack.pop_back();
+		++result;
+		for(ChildRef const & child : children(m_d, n)) {
+			stack.push_back(child.begin);
+		}
+	}
+	return result;
+}
+
+sserialize::ItemIndex
+SerializedHcqr::items() const {
+	std::vector<sserialize::ItemIndex> parts;
+	std::vector<SizeType> stack;
+	if (!empty()) {
+		stack.push_back(0);
+	}
+	while (stack.size()) {
+		Node n = node(m_d, stack.back());
+		stack.pop_back();
+		if (n.type == NT_FULL_MATCH) {
+			parts.emplace_back(cellItems(n.pixelId));
+		}
+		else if (n.type == NT_PARTIAL_MATCH) {
+			parts.emplace_back(partialItems(m_d, n));
+		}
+		else {
+			for(ChildRef const & child : children(m_d, n)) {
+				stack.push_back(child.begin);
+			}
+		}
+	}
+	return sserialize::ItemIndex::unite(parts);
+}
+
+SerializedHcqr::Node
+SerializedHcqr::node(sserialize::UByteArrayAdapter const & data, SizeType offset) {
+	sserialize::UByteArrayAdapter d(data, offset);
+	Node result;
+	result.begin = offset;
+	result.pixelId = d.getVlPackedUint64();
+	result.type = NodeType(d.getUint8());
+	if (result.type == NT_INTERNAL) {
+		result.count = d.getUint32();
+		SizeType childrenSize = d.getUint64();
+		SizeType tableSize = d.getUint32();
+		result.childrenBegin = offset+d.tellGetPtr();
+		result.payloadBegin = result.childrenBegin+childrenSize;
+		result.end = result.payloadBegin+tableSize;
+	}
+	else if (result.type == NT_PARTIAL_MATCH) {
+		result.count = d.getVlPackedUint32();
+		SizeType size = d.getVlPackedUint64();
+		result.payloadBegin = offset+d.tellGetPtr();
+		result.end = result.payloadBegin+size;
+	}
+	else {
+		result.payloadBegin = result.end = offset+d.tellGetPtr();
+	}
+	if (result.type != NT_INTERNAL) {
+		result.childrenBegin = result.end;
+	}
+	return result;
+}
+
+std::vector<SerializedHcqr::ChildRef>
+SerializedHcqr::children(sserialize::UByteArrayAdapter const & data, Node const & node) {
+	std::vector<ChildRef> result;
+	if (node.type != NT_INTERNAL) {
+		return result;
+	}
+	result.reserve(node.count);
+	sserialize::UByteArrayAdapter d(data, node.payloadBegin);
+	SizeType begin = node.childrenBegin;
+	for(uint32_t i(0); i < node.count; ++i) {
+		ChildRef child;
+		child.pixelId = d.getVlPackedUint64();
+		child.begin = begin;
+		child.end = begin + d.getVlPackedUint64();
+		begin = child.end;
+		result.push_back(child);
+	}
+	return result;
+}
+
+std::vector<uint32_t>
+SerializedHcqr::partialItems(sserialize::UByteArrayAdapter const & data, Node const & node) {
+	std::vector<uint32_t> result;
+	result.reserve(node.count);
+	sserialize::UByteArrayAdapter d(data, node.payloadBegin);
+	uint32_t prev = 0;
+	for(uint32_t i(0); i < node.count; ++i) {
+		prev += d.getVlPackedUint32();
+		result.push_back(prev);
+	}
+	return result;
+}
+
+void
+SerializedHcqr::putFull(PixelId pixelId, sserialize::UByteArrayAdapter & dest) {
+	dest.putVlPackedUint64(pixelId);
+	dest.putUint8(NT_FULL_MATCH);
+}
+
+void
+SerializedHcqr::putPartial(PixelId pixelId, std::vector<uint32_t> const & items, sserialize::UByteArrayAdapter & dest) {
+	if (!items.size()) {
+		return;
+	}
+	sserialize::UByteArrayAdapter tmp(0, sserialize::MM_PROGRAM_MEMORY);
+	uint32_t prev = 0;
+	for(uint32_t itemId : items) {
+		tmp.putVlPackedUint32(itemId-prev);
+		prev = itemId;
+	}
+	dest.putVlPackedUint64(pixelId);
+	dest.putUint8(NT_PARTIAL_MATCH);
+	dest.putVlPackedUint32(items.size());
+	dest.putVlPackedUint64(tmp.size());
+	dest.put(tmp);
+}
+
+SerializedHcqr::SizeType
+SerializedHcqr::beginInternal(PixelId pixelId, sserialize::UByteArrayAdapter & dest) {
+	SizeType begin = dest.tellPutPtr();
+	dest.putVlPackedUint64(pixelId);
+	dest.putUint8(NT_INTERNAL);
+	//filled in by endInternal()
+	dest.putUint32(0);
+	dest.putUint64(0);
+	dest.putUint32(0);
+	return begin;
+}
+
+void
+SerializedHcqr::endInternal(SizeType begin, std::vector<ChildRef> const & children, sserialize::UByteArrayAdapter & dest) {
+	if (!children.size()) {
+		dest.setPutPtr(begin);
+		dest.shrinkToPutPtr();
+		return;
+	}
+	SizeType tableBegin = dest.tellPutPtr();
+	for(ChildRef const & child : children) {
+		dest.putVlPackedUint64(child.pixelId);
+		dest.putVlPackedUint64(child.end-child.begin);
+	}
+	sserialize::UByteArrayAdapter d(dest, begin);
+	d.getVlPackedUint64();
+	d.getUint8();
+	SizeType header = begin+d.tellGetPtr();
+	SizeType childrenBegin = header+4+8+4;
+	dest.putUint32(header, children.size());
+	dest.putUint64(header+4, tableBegin-childrenBegin);
+	dest.putUint32(header+4+8, dest.tellPutPtr()-tableBegin);
+}
+
+sserialize::ItemIndex
+SerializedHcqr::cellItems(PixelId pixel) const {
+	std::vector<uint32_t> cellIds;
+	m_ctx->cells->cellIds(pixel, cellIds);
+	std::vector<sserialize::ItemIndex> parts;
+	parts.reserve(cellIds.size());
+	for(uint32_t cellId : cellIds) {
+		parts.emplace_back(m_ctx->idxStore.at( m_ctx->sgInfo->itemIndexId(cellId) ));
+	}
+	return sserialize::ItemIndex::unite(parts);
+}
+
+//END SerializedHcqr
+
+}//end namespace hic
@@ -0,0 +1,255 @@
+#include <hic/SerializedHcqrIndex.h>
+#include <hic/SuccinctHcqr.h>
+#include <sserialize/Static/Version.h>
+#include <sserialize/utility/exceptions.h>
+
+#include <array>
+
+namespace hic::Static {
+
+//BEGIN SerializedHcqrTextIndex
+
+SerializedHcqrTextIndex::SerializedHcqrTextIndex(sserialize::UByteArrayAdapter const & d, sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base) :
+m_base(base),
+m_ctx(makeContext(*base)),
+m_treeFormat(TreeFormat(sserialize::Static::ensureVersion(d, MetaData::version, d.at(0)).at(1))),
+m_mixed(d+2),
+m_items(d+(2+m_mixed.getSizeInBytes())),
+m_regions(d+(2+m_mixed.getSizeInBytes()+m_items.getSizeInBytes()))
+{
+	if (m_treeFormat != OscarSearchHCQRTextIndexCreator::TF_SERIALIZED_HCQR && m_treeFormat != OscarSearchHCQRTextIndexCreator::TF_SUCCINCT_HCQR) {
+		throw sserialize::UnsupportedFeatureException("SerializedHcqrTextIndex: unsupported tree format");
+	}
+	if (m_mixed.size() != m_base->trie().size()) {
+		throw sserialize::TypeMissMatchException("SerializedHcqrTextIndex: payloads do not match the trie of the base index");
+	}
+}
+
+SerializedHcqrTextIndex::~SerializedHcqrTextIndex() {}
+
+sserialize::RCPtrWrapper<SerializedHcqrTextIndex>
+SerializedHcqrTextIndex::make(sserialize::UByteArrayAdapter const & d, sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base) {
+	return sserialize::RCPtrWrapper<Self>( new Self(d, base) );
+}
+
+SerializedHcqr::ContextPtr
+SerializedHcqrTextIndex::makeContext(OscarSearchSgIndex const & index) {
+	auto ctx = std::make_shared<SerializedHcqr::Context>();
+	ctx->sg = index.sgPtr();
+	ctx->sgInfo = index.sgInfoPtr();
+	ctx->idxStore = index.idxStore();
+	ctx->cells = index.sgCells();
+	return ctx;
+}
+
+SerializedHcqr
+SerializedHcqrTextIndex::complete(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source) const {
+	if (m_treeFormat == OscarSearchHCQRTextIndexCreator::TF_SUCCINCT_HCQR) {
+		return SuccinctHcqr(tree(qstr, qt, source), m_ctx).toSerialized();
+	}
+	return SerializedHcqr(tree(qstr, qt, source), m_ctx);
+}
+
+sserialize::ItemIndex
+SerializedHcqrTextIndex::items(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source) const {
+	if (m_treeFormat == OscarSearchHCQRTextIndexCreator::TF_SUCCINCT_HCQR) {
+		return SuccinctHcqr(tree(qstr, qt, source), m_ctx).items();
+	}
+	return SerializedHcqr(tree(qstr, qt, source), m_ctx).items();
+}
+
+sserialize::UByteArrayAdapter
+SerializedHcqrTextIndex::tree(std::string const & qstr, sserialize::StringCompleter::QuerryType qt, PayloadSource source) const {
+	sserialize::UByteArrayAdapter none(0, sserialize::MM_PROGRAM_MEMORY);
+	auto pos = m_base->position(qstr, qt);
+	if (pos == m_base->trie().npos) {
+		return none;
+	}
+	sserialize::UByteArrayAdapter payload = payloads(source).at(pos);
+	sserialize::StringCompleter::QuerryType match;
+	try {
+		match = OscarSearchSgIndex::payloadQueryType(payload.at(0), qt);
+	}
+	catch (sserialize::OutOfBoundsException const &) {
+		return none;
+	}
+	return tree(payload, match);
+}
+
+sserialize::UByteArrayAdapter
+SerializedHcqrTextIndex::tree(sserialize::UByteArrayAdapter const & payload, sserialize::StringCompleter::QuerryType qt) const {
+	sserialize::UByteArrayAdapter none(0, sserialize::MM_PROGRAM_MEMORY);
+	int types = payload.at(0);
+	//trees are stored in this order, only the ones before the match are skipped
+	std::array<sserialize::StringCompleter::QuerryType, 4> pqt{
+		sserialize::StringCompleter::QT_EXACT,
+		sserialize::StringCompleter::QT_PREFIX,
+		sserialize::StringCompleter::QT_SUFFIX,
+		sserialize::StringCompleter::QT_SUBSTRING
+	};
+	sserialize::UByteArrayAdapter::SizeType offset = 1;
+	for(auto x : pqt) {
+		if (!(types & x)) {
+			continue;
+		}
+		sserialize::UByteArrayAdapter d(payload, offset);
+		uint32_t header = d.getVlPackedUint32();
+		if (header & 1) {
+			auto refSource = PayloadSource(d.getUint8());
+			uint32_t refPosition = d.getVlPackedUint32();
+			auto refQt = sserialize::StringCompleter::QuerryType(d.getUint8());
+			if (x == qt) {
+				return tree(payloads(refSource).at(refPosition), refQt);
+			}
+			offset += d.tellGetPtr();
+			continue;
+		}
+		offset += d.tellGetPtr();
+		if (x == qt) {
+			return sserialize::UByteArrayAdapter(payload, offset, header >> 1);
+		}
+		offset += header >> 1;
+	}
+	return none;
+}
+
+SerializedHcqr
+SerializedHcqrTextIndex::fromCqr(sserialize::CellQueryResult const & cqr) const {
+	return SerializedHcqr::fromCqr(cqr, m_ctx);
+}
+
+SerializedHcqr
+SerializedHcqrTextIndex::fromCovering(SpatialGridCovering const & covering) const {
+	return SerializedHcqr::fromCovering(covering, m_ctx);
+}
+
+SerializedHcqr
+SerializedHcqrTextIndex::empty() const {
+	return SerializedHcqr(sserialize::UByteArrayAdapter(0, sserialize::MM_PROGRAM_MEMORY), m_ctx);
+}
+
+sserialize::Static::Array<sserialize::UByteArrayAdapter> const &
+SerializedHcqrTextIndex::payloads(PayloadSource source) const {
+	switch (source) {
+	case OscarSearchSgIndex::PS_ITEMS:
+		return m_items;
+	case OscarSearchSgIndex::PS_REGIONS:
+		return m_regions;
+	case OscarSearchSgIndex::PS_MIXED:
+	default:
+		return m_mixed;
+	};
+}
+
+//END SerializedHcqrTextIndex
+
+//BEGIN SerializedHcqrOpTree
+
+SerializedHcqrOpTree::SerializedHcqrOpTree(sserialize::RCPtrWrapper<SerializedHcqrTextIndex> const & d) :
+m_d(d)
+{}
+
+SerializedHcqrOpTree::~SerializedHcqrOpTree() {}
+
+SerializedHcqr
+SerializedHcqrOpTree::calc() {
+	return calc(root());
+}
+
+sserialize::ItemIndex
+SerializedHcqrOpTree::items() {
+	const Node * node = root();
+	if (node && node->baseType == Node::LEAF && node->value.size() &&
+		(node->subType == Node::STRING || node->subType == Node::STRING_ITEM || node->subType == Node::STRING_REGION))
+	{
+		m_deadline.check("SerializedHcqrOpTree");
+		std::string qstr(node->value);
+		sserialize::StringCompleter::QuerryType qt = sserialize::StringCompleter::normalize(qstr);
+		if (node->subType == Node::STRING_ITEM) {
+			return m_d->items(qstr, qt, OscarSearchSgIndex::PS_ITEMS);
+		}
+		else if (node->subType == Node::STRING_REGION) {
+			return m_d->items(qstr, qt, OscarSearchSgIndex::PS_REGIONS);
+		}
+		return m_d->items(qstr, qt, OscarSearchSgIndex::PS_MIXED);
+	}
+	return calc().items();
+}
+
+SerializedHcqr
+SerializedHcqrOpTree::calc(const Node * node) {
+	if (!node) {
+		return m_d->empty();
+	}
+	m_deadline.check("SerializedHcqrOpTree");
+	OscarSearchSgIndex const & base = m_d->base();
+	switch (node->baseType) {
+	case Node::LEAF:
+		switch (node->subType) {
+		case Node::STRING:
+		case Node::STRING_REGION:
+		case Node::STRING_ITEM:
+		{
+			if (!node->value.size()) {
+				return m_d->empty();
+			}
+			std::string qstr(node->value);
+			sserialize::StringCompleter::QuerryType qt = sserialize::StringCompleter::normalize(qstr);
+			if (node->subType == Node::STRING_ITEM) {
+				return m_d->complete(qstr, qt, OscarSearchSgIndex::PS_ITEMS);
+			}
+			else if (node->subType == Node::STRING_REGION) {
+				return m_d->complete(qstr, qt, OscarSearchSgIndex::PS_REGIONS);
+			}
+			return m_d->complete(qstr, qt, OscarSearchSgIndex::PS_MIXED);
+		}
+		case Node::REGION:
+			return m_d->fromCqr(base.region<sserialize::CellQueryResult>(std::atoi(node->value.c_str())));
+		case Node::REGION_EXCLUSIVE_CELLS:
+			return m_d->fromCqr(base.regionExclusiveCells<sserialize::CellQueryResult>(std::atoi(node->value.c_str())));
+		case Node::CELL:
+			return m_d->fromCqr(base.cell<sserialize::CellQueryResult>(std::atoi(node->value.c_str())));
+		case Node::CELLS:
+			return m_d->fromCqr(base.cells<sserialize::CellQueryResult>(hic::SpatialGridCoverer::parseCellIds(node->value)));
+		case Node::RECT:
+			return m_d->fromCovering(hic::SpatialGridCoverer(base.sg()).cover(sserialize::spatial::GeoRect(node->value, true)));
+		case Node::POLYGON:
+			return m_d->fromCovering(hic::SpatialGridCoverer(base.sg()).polygon(hic::SpatialGridCoverer::parsePolygon(node->value), base.sg().defaultLevel()));
+		case Node::PATH:
+		{
+			auto path = hic::SpatialGridCoverer::parsePath(node->value);
+			return m_d->fromCovering(hic::SpatialGridCoverer(base.sg()).path(path.first, path.second, base.sg().defaultLevel()));
+		}
+		case Node::ITEM:
+			return m_d->fromCqr(base.item<sserialize::CellQueryResult>(std::atoi(node->value.c_str())));
+		default:
+			throw sserialize::UnsupportedFeatureException("SerializedHcqrOpTree: leaf type");
+		};
+	case Node::BINARY_OP:
+		if (node->subType == Node::SET_OP) {
+			SerializedHcqr a = calc(node->children.front());
+			SerializedHcqr b = calc(node->children.back());
+			m_deadline.check("SerializedHcqrOpTree");
+			switch (node->value.at(0)) {
+			case '+':
+				return a + b;
+			case '/':
+			case ' ':
+				return a / b;
+			case '-':
+				return a - b;
+			case '^':
+				return (a - b) + (b - a);
+			default:
+				return m_d->empty();
+			};
+		}
+		throw sserialize::UnsupportedFeatureException("SerializedHcqrOpTree: binary operation");
+	default:
+		throw sserialize::UnsupportedFeatureException("SerializedHcqrOpTree: unary operation");
+	};
+}
+
+//END SerializedHcqrOpTree
+
+}//end namespace hic::Static
@@ -0,0 +1,66 @@
+#include <hic/SpatialGridCells.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace hic {
+
+SpatialGridCells::SpatialGridCells(sserialize::RCPtrWrapper<SpatialGrid> const & sg, std::shared_ptr<SpatialGridInfo> const & sgInfo) :
+m_sg(sg),
+m_sgInfo(sgInfo)
+{
+	std::unordered_set<PixelId> ancestors;
+	for(uint32_t cellId(0), s(m_sgInfo->cPixelCount()); cellId < s; ++cellId) {
+		PixelId pixel = m_sgInfo->sgIndex(cellId);
+		//all ancestors of an ancestor that was already seen were added as well
+		while (pixel != m_sg->rootPixelId()) {
+			pixel = m_sg->parent(pixel);
+			if (!ancestors.insert(pixel).second) {
+				break;
+			}
+		}
+	}
+	m_ancestors.assign(ancestors.begin(), ancestors.end());
+	std::sort(m_ancestors.begin(), m_ancestors.end());
+}
+
+SpatialGridCells::~SpatialGridCells() {}
+
+bool
+SpatialGridCells::contains(PixelId pixel) const {
+	if (m_sg->level(pixel) >= m_sg->defaultLevel()) {
+		return m_sgInfo->hasSgIndex(pixel);
+	}
+	return std::binary_search(m_ancestors.begin(), m_ancestors.end(), pixel);
+}
+
+std::vector<SpatialGridCells::PixelId>
+SpatialGridCells::children(PixelId pixel) const {
+	std::vector<PixelId> result;
+	if (m_sg->level(pixel) >= m_sg->defaultLevel() || !contains(pixel)) {
+		return result;
+	}
+	for(uint32_t i(0), s(m_sg->childrenCount(pixel)); i < s; ++i) {
+		PixelId child = m_sg->index(pixel, i);
+		if (contains(child)) {
+			result.push_back(child);
+		}
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+void
+SpatialGridCells::cellIds(PixelId pixel, std::vector<uint32_t> & dest) const {
+	if (m_sg->level(pixel) >= m_sg->defaultLevel()) {
+		if (m_sgInfo->hasSgIndex(pixel)) {
+			dest.push_back(m_sgInfo->cPixelId(pixel));
+		}
+		return;
+	}
+	for(PixelId child : children(pixel)) {
+		cellIds(child, dest);
+	}
+}
+
+}//end namespace hic
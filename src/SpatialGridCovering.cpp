@@ -0,0 +1,442 @@
+#include <hic/SpatialGridCovering.h>
+#include <hic/HtmSpatialGrid.h>
+#include <hic/H3SpatialGrid.h>
+#include <hic/S2GeomSpatialGrid.h>
+
+#include <sserialize/utility/exceptions.h>
+#include <sserialize/utility/assert.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <unordered_set>
+
+namespace hic {
+namespace {
+
+using GeoPoint = sserialize::spatial::GeoPoint;
+using GeoRect = sserialize::spatial::GeoRect;
+
+///Length of a degree of latitude on a spherical earth, used for all distances, see SpatialGridCoverer
+constexpr double MetersPerDegree = 111319.49;
+
+bool contains(GeoRect const & rect, GeoPoint const & p) {
+	return rect.minLat() <= p.lat() && p.lat() <= rect.maxLat() && rect.minLon() <= p.lon() && p.lon() <= rect.maxLon();
+}
+
+double cross(double ax, double ay, double bx, double by, double cx, double cy) {
+	return (bx-ax)*(cy-ay) - (by-ay)*(cx-ax);
+}
+
+bool segmentsIntersect(GeoPoint const & a, GeoPoint const & b, GeoPoint const & c, GeoPoint const & d) {
+	double d1 = cross(c.lon(), c.lat(), d.lon(), d.lat(), a.lon(), a.lat());
+	double d2 = cross(c.lon(), c.lat(), d.lon(), d.lat(), b.lon(), b.lat());
+	double d3 = cross(a.lon(), a.lat(), b.lon(), b.lat(), c.lon(), c.lat());
+	double d4 = cross(a.lon(), a.lat(), b.lon(), b.lat(), d.lon(), d.lat());
+	return ((d1 <= 0 && d2 >= 0) || (d1 >= 0 && d2 <= 0)) && ((d3 <= 0 && d4 >= 0) || (d3 >= 0 && d4 <= 0));
+}
+
+std::array<GeoPoint, 4> corners(GeoRect const & rect) {
+	return std::array<GeoPoint, 4>{{
+		GeoPoint(rect.minLat(), rect.minLon()),
+		GeoPoint(rect.minLat(), rect.maxLon()),
+		GeoPoint(rect.maxLat(), rect.maxLon()),
+		GeoPoint(rect.maxLat(), rect.minLon())
+	}};
+}
+
+bool segmentIntersects(GeoRect const & rect, GeoPoint const & a, GeoPoint const & b) {
+	if (contains(rect, a) || contains(rect, b)) {
+		return true;
+	}
+	auto c = corners(rect);
+	for(std::size_t i(0); i < 4; ++i) {
+		if (segmentsIntersect(a, b, c[i], c[(i+1)%4])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+///even-odd rule
+bool polygonContains(std::vector<GeoPoint> const & points, GeoPoint const & p) {
+	bool inside = false;
+	for(std::size_t i(0), j(points.size()-1), s(points.size()); i < s; j = i++) {
+		GeoPoint const & a = points[i];
+		GeoPoint const & b = points[j];
+		if ((a.lat() > p.lat()) != (b.lat() > p.lat())) {
+			double lon = (b.lon()-a.lon()) * (p.lat()-a.lat()) / (b.lat()-a.lat()) + a.lon();
+			if (p.lon() < lon) {
+				inside = !inside;
+			}
+		}
+	}
+	return inside;
+}
+
+///Distance in meters of p to the segment ab using an equirectangular projection centered at p
+double segmentDistance(GeoPoint const & p, GeoPoint const & a, GeoPoint const & b) {
+	double lonScale = std::cos(p.lat() * M_PI / 180.0);
+	double ax = (a.lon()-p.lon())*lonScale, ay = a.lat()-p.lat();
+	double bx = (b.lon()-p.lon())*lonScale, by = b.lat()-p.lat();
+	double dx = bx-ax, dy = by-ay;
+	double len2 = dx*dx + dy*dy;
+	double t = 0;
+	if (len2 > 0) {
+		t = std::max<double>(0, std::min<double>(1, -(ax*dx + ay*dy)/len2));
+	}
+	double x = ax + t*dx, y = ay + t*dy;
+	return std::sqrt(x*x + y*y)*MetersPerDegree;
+}
+
+double segmentDistance(GeoRect const & rect, GeoPoint const & a, GeoPoint const & b) {
+	if (segmentIntersects(rect, a, b)) {
+		return 0;
+	}
+	double result = std::numeric_limits<double>::max();
+	for(GeoPoint const & c : corners(rect)) {
+		result = std::min(result, segmentDistance(c, a, b));
+	}
+	//Closest points may be an endpoint of the segment and an edge of the rect
+	for(GeoPoint const & p : {a, b}) {
+		GeoPoint q(std::max(rect.minLat(), std::min(rect.maxLat(), p.lat())), std::max(rect.minLon(), std::min(rect.maxLon(), p.lon())));
+		result = std::min(result, segmentDistance(p, q, q));
+	}
+	return result;
+}
+
+///Relations are planar in lat/lon, hence an edge spanning more than half of the longitudes would wrap the wrong way around
+void checkAntimeridian(std::vector<GeoPoint> const & points, bool closed, char const * what) {
+	for(std::size_t i(0), s(points.size()); i < s && (closed || i+1 < s); ++i) {
+		if (std::abs(points[i].lon() - points[(i+1)%s].lon()) > 180) {
+			throw sserialize::UnsupportedFeatureException(std::string(what) + " crosses the antimeridian, split it into parts on either side");
+		}
+	}
+}
+
+std::vector<double> parseNumbers(std::string const & str) {
+	std::vector<double> result;
+	const char * it = str.c_str();
+	while (*it) {
+		char * end;
+		double v = std::strtod(it, &end);
+		if (end == it) {
+			++it;
+		}
+		else {
+			result.push_back(v);
+			it = end;
+		}
+	}
+	return result;
+}
+
+std::vector<GeoPoint> toPoints(std::vector<double>::const_iterator it, std::vector<double>::const_iterator end) {
+	std::vector<GeoPoint> result;
+	for(; it != end && it+1 != end; it += 2) {
+		result.emplace_back(*it, *(it+1));
+	}
+	return result;
+}
+
+} //end anonymous namespace
+
+SpatialGridCoverer::SpatialGridCoverer(SpatialGrid const & sg) :
+m_sg(sg)
+{}
+
+SpatialGridCoverer::~SpatialGridCoverer() {}
+
+SpatialGridCovering
+SpatialGridCoverer::cover(sserialize::spatial::GeoRect const & rect, Level level) const {
+	return cover([&rect](GeoRect const & pixel) {
+		return relation(rect, pixel);
+	}, level);
+}
+
+SpatialGridCovering
+SpatialGridCoverer::cover(sserialize::spatial::GeoRect const & rect) const {
+	return cover(rect, m_sg.defaultLevel());
+}
+
+SpatialGridCovering
+SpatialGridCoverer::polygon(std::vector<GeoPoint> const & points, Level level) const {
+	if (points.size() < 3) {
+		return SpatialGridCovering();
+	}
+	checkAntimeridian(points, true, "SpatialGridCoverer::polygon: polygon");
+	SpatialGridCovering result = cover([&points](GeoRect const & pixel) {
+		return polygonRelation(points, pixel);
+	}, level);
+	#ifdef SSERIALIZE_EXPENSIVE_ASSERT_ENABLED
+	//Cells of points inside the polygon have to be covered, this fails if pixel boxes or prune boxes are wrong (e.g. h3)
+	{
+		std::unordered_set<PixelId> covered(result.interior.begin(), result.interior.end());
+		covered.insert(result.boundary.begin(), result.boundary.end());
+		for(std::size_t i(1), s(points.size()); i+1 < s; ++i) {
+			GeoPoint p(
+				(points[0].lat()+points[i].lat()+points[i+1].lat())/3,
+				(points[0].lon()+points[i].lon()+points[i+1].lon())/3
+			);
+			if (!polygonContains(points, p)) {
+				continue;
+			}
+			PixelId pixel = m_sg.index(p.lat(), p.lon(), level);
+			while (pixel != m_sg.rootPixelId() && !covered.count(pixel)) {
+				pixel = m_sg.parent(pixel);
+			}
+			SSERIALIZE_EXPENSIVE_ASSERT(pixel != m_sg.rootPixelId());
+		}
+	}
+	#endif
+	return result;
+}
+
+SpatialGridCovering
+SpatialGridCoverer::path(double radius, std::vector<GeoPoint> const & points, Level level) const {
+	if (!points.size()) {
+		return SpatialGridCovering();
+	}
+	checkAntimeridian(points, false, "SpatialGridCoverer::path: path");
+	return cover([radius, &points](GeoRect const & pixel) {
+		return pathRelation(radius, points, pixel);
+	}, level);
+}
+
+SpatialGridCovering
+SpatialGridCoverer::cover(RelationFunction const & rel, Level level) const {
+	SpatialGridCovering result;
+	cover(m_sg.rootPixelId(), level, rel, result);
+	return result;
+}
+
+SpatialGridCoverer::Relation
+SpatialGridCoverer::relation(sserialize::spatial::GeoRect const & region, sserialize::spatial::GeoRect const & pixel) {
+	if (!region.overlap(pixel)) {
+		return R_DISJOINT;
+	}
+	if (region.contains(pixel)) {
+		return R_CONTAINED;
+	}
+	return R_INTERSECTS;
+}
+
+SpatialGridCoverer::Relation
+SpatialGridCoverer::polygonRelation(std::vector<GeoPoint> const & points, GeoRect const & pixel) {
+	for(std::size_t i(0), s(points.size()); i < s; ++i) {
+		if (segmentIntersects(pixel, points[i], points[(i+1)%s])) {
+			return R_INTERSECTS;
+		}
+	}
+	//No edge crosses the pixel, hence the pixel is either completely inside or outside
+	if (polygonContains(points, GeoPoint(pixel.midLat(), pixel.midLon()))) {
+		return R_CONTAINED;
+	}
+	return R_DISJOINT;
+}
+
+SpatialGridCoverer::Relation
+SpatialGridCoverer::pathRelation(double radius, std::vector<GeoPoint> const & points, GeoRect const & pixel) {
+	Relation result = R_DISJOINT;
+	for(std::size_t i(0), s(points.size()); i < s; ++i) {
+		GeoPoint const & a = points[i];
+		GeoPoint const & b = points[i+1 < s ? i+1 : i];
+		if (segmentDistance(pixel, a, b) > radius) {
+			continue;
+		}
+		result = R_INTERSECTS;
+		//The distance to a segment is convex, the maximum over the pixel is attained at a corner
+		bool contained = true;
+		for(GeoPoint const & c : corners(pixel)) {
+			if (segmentDistance(c, a, b) > radius) {
+				contained = false;
+				break;
+			}
+		}
+		if (contained) {
+			return R_CONTAINED;
+		}
+	}
+	return result;
+}
+
+double
+SpatialGridCoverer::distance(GeoPoint const & p, GeoRect const & rect) {
+	GeoPoint q(std::max(rect.minLat(), std::min(rect.maxLat(), p.lat())), std::max(rect.minLon(), std::min(rect.maxLon(), p.lon())));
+	return segmentDistance(p, q, q);
+}
+
+std::vector<SpatialGridCoverer::GeoPoint>
+SpatialGridCoverer::parsePolygon(std::string const & str) {
+	std::vector<double> v = parseNumbers(str);
+	return toPoints(v.cbegin(), v.cend());
+}
+
+std::pair<double, std::vector<SpatialGridCoverer::GeoPoint>>
+SpatialGridCoverer::parsePath(std::string const & str) {
+	std::vector<double> v = parseNumbers(str);
+	if (!v.size()) {
+		return std::pair<double, std::vector<GeoPoint>>(0, std::vector<GeoPoint>());
+	}
+	return std::pair<double, std::vector<GeoPoint>>(v.front(), toPoints(v.cbegin()+1, v.cend()));
+}
+
+std::vector<uint32_t>
+SpatialGridCoverer::parseCellIds(std::string const & str) {
+	std::vector<uint32_t> result;
+	for(std::size_t i(0), s(str.size()); i < s;) {
+		if (!std::isdigit((unsigned char)(str[i]))) {
+			++i;
+			continue;
+		}
+		uint32_t cellId = 0;
+		for(; i < s && std::isdigit((unsigned char)(str[i])); ++i) {
+			cellId = cellId*10 + (str[i]-'0');
+		}
+		result.push_back(cellId);
+	}
+	return result;
+}
+
+void
+SpatialGridCoverer::cover(PixelId pixel, Level level, RelationFunction const & rel, SpatialGridCovering & dest) const {
+	Level pixelLevel = m_sg.level(pixel);
+	if (pixelLevel == level) {
+		Relation r = rel(m_sg.bbox(pixel));
+		if (r == R_CONTAINED) {
+			dest.interior.push_back(pixel);
+		}
+		else if (r == R_INTERSECTS) {
+			dest.boundary.push_back(pixel);
+		}
+		return;
+	}
+	if (pixel != m_sg.rootPixelId()) {
+		Relation r = rel(pruneBox(pixel, level));
+		if (r == R_DISJOINT) {
+			return;
+		}
+		else if (r == R_CONTAINED) {
+			//the pixel stands for all its descendants, they are resolved to the cells of an index by its users
+			dest.interior.push_back(pixel);
+			return;
+		}
+	}
+	for(uint32_t i(0), s(m_sg.childrenCount(pixel)); i < s; ++i) {
+		cover(m_sg.index(pixel, i), level, rel, dest);
+	}
+}
+
+std::vector<SpatialGridCoverer::PixelId>
+SpatialGridCoverer::neighbours(PixelId pixel) const {
+	if (auto sg = dynamic_cast<HtmSpatialGrid const *>(&m_sg)) {
+		return sg->neighbours(pixel);
+	}
+	else if (auto sg = dynamic_cast<H3SpatialGrid const *>(&m_sg)) {
+		return sg->neighbours(pixel);
+	}
+	else if (auto sg = dynamic_cast<S2GeomSpatialGrid const *>(&m_sg)) {
+		return sg->neighbours(pixel);
+	}
+	std::vector<PixelId> result;
+	if (pixel == m_sg.rootPixelId()) {
+		return result;
+	}
+	//Sample points slightly outside of the corners and edge midpoints of the bounding box
+	Level level = m_sg.level(pixel);
+	GeoRect box = m_sg.bbox(pixel);
+	double dlat = (box.maxLat() - box.minLat())*0.05;
+	double dlon = (box.maxLon() - box.minLon())*0.05;
+	for(double lat : {box.minLat()-dlat, (box.minLat()+box.maxLat())/2, box.maxLat()+dlat}) {
+		for(double lon : {box.minLon()-dlon, (box.minLon()+box.maxLon())/2, box.maxLon()+dlon}) {
+			if (lat < -90 || lat > 90) {
+				continue;
+			}
+			lon = lon < -180 ? lon+360 : (lon > 180 ? lon-360 : lon);
+			PixelId n = m_sg.index(lat, lon, level);
+			if (n != pixel) {
+				result.push_back(n);
+			}
+		}
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+std::vector<SpatialGridCoverer::PixelId>
+SpatialGridCoverer::dilate(std::vector<PixelId> const & pixels, uint32_t rounds) const {
+	std::unordered_set<PixelId> seen(pixels.begin(), pixels.end());
+	std::vector<PixelId> frontier(seen.begin(), seen.end());
+	std::vector<PixelId> next;
+	for(uint32_t round(0); round < rounds && frontier.size(); ++round) {
+		for(PixelId pixel : frontier) {
+			for(PixelId n : neighbours(pixel)) {
+				if (seen.insert(n).second) {
+					next.push_back(n);
+				}
+			}
+		}
+		frontier.swap(next);
+		next.clear();
+	}
+	std::vector<PixelId> result(seen.begin(), seen.end());
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+uint32_t
+SpatialGridCoverer::rounds(PixelId pixel, double distance) const {
+	if (distance <= 0 || pixel == m_sg.rootPixelId()) {
+		return 0;
+	}
+	//area is in square kilometers
+	double width = MinWidthFactor*std::sqrt(m_sg.area(pixel))*1000;
+	return std::ceil(distance / width);
+}
+
+uint32_t
+SpatialGridCoverer::rounds(std::vector<PixelId> const & pixels, double distance) const {
+	uint32_t result = 0;
+	for(PixelId pixel : pixels) {
+		result = std::max(result, rounds(pixel, distance));
+	}
+	return result;
+}
+
+sserialize::spatial::GeoRect
+SpatialGridCoverer::pruneBox(PixelId pixel, Level level) const {
+	GeoRect box = m_sg.bbox(pixel);
+	double minLat = box.minLat(), maxLat = box.maxLat(), minLon = box.minLon(), maxLon = box.maxLon();
+	double childHeight = 0, childWidth = 0;
+	for(uint32_t i(0), s(m_sg.childrenCount(pixel)); i < s; ++i) {
+		GeoRect cb = m_sg.bbox(m_sg.index(pixel, i));
+		minLat = std::min(minLat, cb.minLat());
+		maxLat = std::max(maxLat, cb.maxLat());
+		minLon = std::min(minLon, cb.minLon());
+		maxLon = std::max(maxLon, cb.maxLon());
+		childHeight = std::max(childHeight, cb.maxLat()-cb.minLat());
+		childWidth = std::max(childWidth, cb.maxLon()-cb.minLon());
+	}
+	bool childrenInside = minLat == box.minLat() && maxLat == box.maxLat() && minLon == box.minLon() && maxLon == box.maxLon();
+	if (childrenInside) {
+		return box;
+	}
+	//Children are at the target level, their boxes are exact
+	if (m_sg.level(pixel)+1 >= level) {
+		return GeoRect(minLat, maxLat, minLon, maxLon);
+	}
+	//The center of a child lies within its parent, hence a descendant extends at most its own extent beyond its parent.
+	//Summed over all deeper levels with extents shrinking at least by half per level (1/sqrt(7) in h3)
+	//descendants extend at most the extent of the largest child beyond the boxes of the children.
+	return GeoRect(
+		std::max<double>(-90, minLat-childHeight), std::min<double>(90, maxLat+childHeight),
+		std::max<double>(-180, minLon-childWidth), std::min<double>(180, maxLon+childWidth)
+	);
+}
+
+}//end namespace hic
@@ -0,0 +1,252 @@
+#include <hic/SuccinctHcqr.h>
+#include <sserialize/utility/exceptions.h>
+
+#include <deque>
+
+namespace hic {
+
+SuccinctHcqr::SuccinctHcqr() {}
+
+SuccinctHcqr::SuccinctHcqr(sserialize::UByteArrayAdapter const & data, ContextPtr const & ctx) :
+m_d(data),
+m_ctx(ctx)
+{
+	if (!m_d.size()) {
+		return;
+	}
+	sserialize::UByteArrayAdapter d(m_d, 0);
+	m_nodeCount = d.getVlPackedUint32();
+	m_wordCount = d.getVlPackedUint32();
+	SizeType offset = d.tellGetPtr();
+	m_louds = sserialize::UByteArrayAdapter(m_d, offset, SizeType(m_wordCount)*8);
+	offset += SizeType(m_wordCount)*8;
+	for(auto x : {&m_onesBefore, &m_zeroSamples, &m_childPositions, &m_types, &m_itemsBegin, &m_items}) {
+		*x = sserialize::BoundedCompactUintArray(sserialize::UByteArrayAdapter(m_d, offset));
+		offset += x->getSizeInBytes();
+	}
+}
+
+SuccinctHcqr::~SuccinctHcqr() {}
+
+SuccinctHcqr
+SuccinctHcqr::fromSerialized(SerializedHcqr const & hcqr) {
+	if (hcqr.empty()) {
+		return SuccinctHcqr(sserialize::UByteArrayAdapter(0, sserialize::MM_PROGRAM_MEMORY), hcqr.context());
+	}
+	auto const & sg = *hcqr.context()->sg;
+	sserialize::UByteArrayAdapter const & src = hcqr.data();
+
+	std::vector<uint64_t> louds;
+	uint64_t bitCount = 0;
+	auto pushBit = [&louds, &bitCount](bool v) {
+		if (bitCount % 64 == 0) {
+			louds.push_back(0);
+		}
+		if (v) {
+			louds.back() |= uint64_t(1) << (bitCount % 64);
+		}
+		++bitCount;
+	};
+	std::vector<uint32_t> zeroSamples;
+	uint32_t zeroCount = 0;
+	auto pushZero = [&]() {
+		if (zeroCount % SelectSampleRate == 0) {
+			zeroSamples.push_back(bitCount / 64);
+		}
+		++zeroCount;
+		pushBit(false);
+	};
+	std::vector<uint32_t> childPositions;
+	std::vector<uint32_t> types;
+	std::vector<uint32_t> itemsBegin(1, 0);
+	std::vector<uint32_t> items;
+
+	//super root
+	pushBit(true);
+	pushZero();
+	std::deque<std::pair<SerializedHcqr::Node, uint32_t>> queue;
+	queue.emplace_back(SerializedHcqr::node(src, 0), 0);
+	while (queue.size()) {
+		SerializedHcqr::Node node = queue.front().first;
+		childPositions.push_back(queue.front().second);
+		queue.pop_front();
+		types.push_back(node.type);
+		if (node.type == SerializedHcqr::NT_PARTIAL_MATCH) {
+			std::vector<uint32_t> nodeItems = SerializedHcqr::partialItems(src, node);
+			items.insert(items.end(), nodeItems.begin(), nodeItems.end());
+		}
+		itemsBegin.push_back(items.size());
+		if (node.type == SerializedHcqr::NT_INTERNAL) {
+			for(auto const & ref : SerializedHcqr::children(src, node)) {
+				SerializedHcqr::Node child = SerializedHcqr::node(src, ref.begin);
+				uint32_t pos = 0;
+				for(uint32_t s(sg.childrenCount(node.pixelId)); pos < s && sg.index(node.pixelId, pos) != child.pixelId; ++pos) {}
+				if (pos == sg.childrenCount(node.pixelId)) {
+					throw sserialize::TypeMissMatchException("SuccinctHcqr: node is not a child of its parent pixel");
+				}
+				queue.emplace_back(child, pos);
+				pushBit(true);
+			}
+		}
+		pushZero();
+	}
+
+	std::vector<uint32_t> onesBefore;
+	onesBefore.reserve(louds.size());
+	uint32_t ones = 0;
+	for(uint64_t w : louds) {
+		onesBefore.push_back(ones);
+		ones += __builtin_popcountll(w);
+	}
+
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	data.putVlPackedUint32(types.size());
+	data.putVlPackedUint32(louds.size());
+	for(uint64_t w : louds) {
+		data.putUint64(w);
+	}
+	sserialize::BoundedCompactUintArray::create(onesBefore, data);
+	sserialize::BoundedCompactUintArray::create(zeroSamples, data);
+	sserialize::BoundedCompactUintArray::create(childPositions, data);
+	sserialize::BoundedCompactUintArray::create(types, data);
+	sserialize::BoundedCompactUintArray::create(itemsBegin, data);
+	sserialize::BoundedCompactUintArray::create(items, data);
+	return SuccinctHcqr(data, hcqr.context());
+}
+
+SerializedHcqr
+SuccinctHcqr::toSerialized() const {
+	sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
+	if (!empty()) {
+		serialize(root(), data);
+	}
+	return SerializedHcqr(data, m_ctx);
+}
+
+sserialize::ItemIndex
+SuccinctHcqr::items() const {
+	if (empty()) {
+		return sserialize::ItemIndex();
+	}
+	std::vector<uint32_t> cellIds;
+	std::vector<sserialize::ItemIndex> parts;
+	std::vector<Node> stack(1, root());
+	while (stack.size()) {
+		Node node = stack.back();
+		stack.pop_back();
+		switch (type(node)) {
+		case SerializedHcqr::NT_FULL_MATCH:
+			m_ctx->cells->cellIds(node.pixelId(), cellIds);
+			break;
+		case SerializedHcqr::NT_PARTIAL_MATCH:
+			parts.emplace_back(items(node));
+			break;
+		default:
+			for(uint32_t i(0), s(childCount(node)); i < s; ++i) {
+				stack.push_back(child(node, i));
+			}
+			break;
+		};
+	}
+	for(uint32_t cellId : cellIds) {
+		parts.emplace_back(m_ctx->idxStore.at( m_ctx->sgInfo->itemIndexId(cellId) ));
+	}
+	return sserialize::ItemIndex::unite(parts);
+}
+
+SuccinctHcqr::Node
+SuccinctHcqr::root() const {
+	if (empty()) {
+		return Node();
+	}
+	return Node(0, m_ctx->sg->rootPixelId());
+}
+
+uint32_t
+SuccinctHcqr::childCount(Node const & node) const {
+	return select0(node.id()+2) - select0(node.id()+1) - 1;
+}
+
+SuccinctHcqr::Node
+SuccinctHcqr::child(Node const & node, uint32_t i) const {
+	uint32_t id = rank1(childrenBegin(node.id()) + i);
+	return Node(id, m_ctx->sg->index(node.pixelId(), m_childPositions.at(id)));
+}
+
+SuccinctHcqr::NodeType
+SuccinctHcqr::type(Node const & node) const {
+	return NodeType(m_types.at(node.id()));
+}
+
+std::vector<uint32_t>
+SuccinctHcqr::items(Node const & node) const {
+	std::vector<uint32_t> result;
+	for(uint32_t i(m_itemsBegin.at(node.id())), s(m_itemsBegin.at(node.id()+1)); i < s; ++i) {
+		result.push_back(m_items.at(i));
+	}
+	return result;
+}
+
+uint64_t
+SuccinctHcqr::word(uint32_t i) const {
+	return m_louds.getUint64(SizeType(i)*8);
+}
+
+uint32_t
+SuccinctHcqr::rank1(uint64_t pos) const {
+	uint32_t w = pos / 64;
+	uint32_t b = pos % 64;
+	uint32_t result = m_onesBefore.at(w);
+	if (b) {
+		result += __builtin_popcountll(word(w) & ((uint64_t(1) << b)-1));
+	}
+	return result;
+}
+
+uint64_t
+SuccinctHcqr::select0(uint32_t j) const {
+	uint32_t w = m_zeroSamples.at((j-1)/SelectSampleRate);
+	//SelectSampleRate zeros and the ones of their nodes lie between two samples, see the class documentation
+	uint32_t zerosBefore = w*64 - m_onesBefore.at(w);
+	for(; w < m_wordCount; ++w) {
+		uint64_t x = ~word(w);
+		uint32_t z = __builtin_popcountll(x);
+		if (zerosBefore + z >= j) {
+			for(uint32_t r(j-zerosBefore); r > 1; --r) {
+				x &= x-1;
+			}
+			return uint64_t(w)*64 + __builtin_ctzll(x);
+		}
+		zerosBefore += z;
+	}
+	throw sserialize::OutOfBoundsException("SuccinctHcqr::select0");
+}
+
+void
+SuccinctHcqr::serialize(Node const & node, sserialize::UByteArrayAdapter & dest) const {
+	switch (type(node)) {
+	case SerializedHcqr::NT_FULL_MATCH:
+		SerializedHcqr::putFull(node.pixelId(), dest);
+		break;
+	case SerializedHcqr::NT_PARTIAL_MATCH:
+		SerializedHcqr::putPartial(node.pixelId(), items(node), dest);
+		break;
+	default:
+	{
+		std::vector<SerializedHcqr::ChildRef> refs;
+		SizeType begin = SerializedHcqr::beginInternal(node.pixelId(), dest);
+		for(uint32_t i(0), s(childCount(node)); i < s; ++i) {
+			Node c = child(node, i);
+			SizeType childBegin = dest.tellPutPtr();
+			serialize(c, dest);
+			if (dest.tellPutPtr() != childBegin) {
+				refs.push_back(SerializedHcqr::ChildRef{c.pixelId(), childBegin, dest.tellPutPtr()});
+			}
+		}
+		SerializedHcqr::endInternal(begin, refs, dest);
+	}
+		break;
+	};
+}
+
+}//end namespace hic
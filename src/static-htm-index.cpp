@@ -1,4 +1,6 @@
 #include <hic/static-htm-index.h>
+#include <hic/SerializedHcqrIndex.h>
+#include <hic/SuccinctHcqr.h>
 #include <sserialize/strings/unicode_case_functions.h>
 #include <sserialize/Static/Version.h>
 #include <sserialize/spatial/TreedCQR.h>
@@ -13,17 +15,78 @@
 #include <sserialize/spatial/dgg/Static/HCQRTextIndex.h>
 #include <sserialize/spatial/dgg/Static/SpatialGridRegistry.h>
 
+#include <unordered_set>
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+
 namespace hic::Static {
+namespace {
+
+sserialize::UByteArrayAdapter const &
+ensureSgIndexVersion(sserialize::UByteArrayAdapter const & d) {
+	if (d.at(0) >= OscarSearchSgIndex::MetaData::minVersion && d.at(0) < OscarSearchSgIndex::MetaData::version) {
+		return d;
+	}
+	return sserialize::Static::ensureVersion(d, OscarSearchSgIndex::MetaData::version, d.at(0));
+}
+
+using PixelCounts = std::unordered_map<sserialize::spatial::dgg::interface::SpatialGrid::PixelId, uint32_t>;
+
+///Adds count to the ancestor of pixel at level, or to pixel itself if it is not below level
+void
+addPixelCount(sserialize::spatial::dgg::interface::SpatialGrid const & sg, sserialize::spatial::dgg::interface::SpatialGrid::PixelId pixel, uint32_t level, uint32_t count, PixelCounts & dest) {
+	while (uint32_t(sg.level(pixel)) > level) {
+		pixel = sg.parent(pixel);
+	}
+	dest[pixel] += count;
+}
+
+std::vector<hic::PixelCount>
+sortedPixelCounts(PixelCounts const & counts) {
+	std::vector<hic::PixelCount> result;
+	result.reserve(counts.size());
+	for(auto const & x : counts) {
+		result.push_back(hic::PixelCount{x.first, x.second});
+	}
+	std::sort(result.begin(), result.end(), [](hic::PixelCount const & a, hic::PixelCount const & b) {
+		return a.pixelId < b.pixelId;
+	});
+	return result;
+}
+
+} //end anonymous namespace
 
 OscarSearchSgIndex::OscarSearchSgIndex(const sserialize::UByteArrayAdapter & d, const sserialize::Static::ItemIndexStore & idxStore) :
-m_sq(sserialize::Static::ensureVersion(d, MetaData::version, d.at(0)).at(1)),
+m_sq(ensureSgIndexVersion(d).at(1)),
 m_sgInfo( std::make_shared<SpatialGridInfo>(d+2) ),
 m_trie(d+(2+sgInfo().getSizeInBytes())),
 m_mixed(d+(2+sgInfo().getSizeInBytes()+m_trie.getSizeInBytes())),
 m_regions(d+(2+sgInfo().getSizeInBytes()+m_trie.getSizeInBytes()+m_mixed.getSizeInBytes())),
 m_items(d+(2+sgInfo().getSizeInBytes()+m_trie.getSizeInBytes()+m_mixed.getSizeInBytes()+m_regions.getSizeInBytes())),
+m_version(d.at(0)),
 m_idxStore(idxStore)
 {
+	if (m_version >= 3) {
+		auto rd = d+(2+sgInfo().getSizeInBytes()+m_trie.getSizeInBytes()+m_mixed.getSizeInBytes()+m_regions.getSizeInBytes()+m_items.getSizeInBytes());
+		m_regionStoreIds = RegionStoreIdMap(rd);
+		m_regionCells = Payloads(rd+m_regionStoreIds.getSizeInBytes());
+		if (m_version >= 4) {
+			auto fd = rd+(m_regionStoreIds.getSizeInBytes()+m_regionCells.getSizeInBytes());
+			m_features = fd.at(0);
+			fd = fd+1;
+			if (hasItemCells()) {
+				m_itemCellsBegin = sserialize::BoundedCompactUintArray(fd);
+				m_itemCells = sserialize::BoundedCompactUintArray(fd+m_itemCellsBegin.getSizeInBytes());
+				fd = fd+(m_itemCellsBegin.getSizeInBytes()+m_itemCells.getSizeInBytes());
+			}
+			if (hasRegionExclusiveCells()) {
+				m_regionExclusiveCells = Payloads(fd);
+			}
+		}
+	}
 	m_sg = sserialize::spatial::dgg::Static::SpatialGridRegistry::get().get(sgInfo());
 }
 
@@ -37,7 +100,20 @@ OscarSearchSgIndex::~OscarSearchSgIndex() {}
 
 sserialize::UByteArrayAdapter::SizeType
 OscarSearchSgIndex::getSizeInBytes() const {
-	return 2+m_sgInfo->getSizeInBytes()+m_trie.getSizeInBytes()+m_mixed.getSizeInBytes()+m_items.getSizeInBytes()+m_regions.getSizeInBytes();
+	sserialize::UByteArrayAdapter::SizeType result = 2+m_sgInfo->getSizeInBytes()+m_trie.getSizeInBytes()+m_mixed.getSizeInBytes()+m_items.getSizeInBytes()+m_regions.getSizeInBytes();
+	if (hasRegionCells()) {
+		result += m_regionStoreIds.getSizeInBytes()+m_regionCells.getSizeInBytes();
+	}
+	if (m_version >= 4) {
+		result += 1;
+	}
+	if (hasItemCells()) {
+		result += m_itemCellsBegin.getSizeInBytes()+m_itemCells.getSizeInBytes();
+	}
+	if (hasRegionExclusiveCells()) {
+		result += m_regionExclusiveCells.getSizeInBytes();
+	}
+	return result;
 }
 
 sserialize::Static::ItemIndexStore const &
@@ -65,6 +141,17 @@ OscarSearchSgIndex::getSupportedQueries() const {
 
 OscarSearchSgIndex::Payload::Type
 OscarSearchSgIndex::typeFromCompletion(const std::string& qs, const sserialize::StringCompleter::QuerryType qt, Payloads const & pd) const {
+	auto pos = position(qs, qt);
+	
+	if (pos == m_trie.npos) {
+		throw sserialize::OutOfBoundsException("OscarSearchSgIndex::typeFromCompletion");
+	}
+	
+	return typeFromPayload(Payload( pd.at(pos) ), qt);
+}
+
+sserialize::UByteArrayAdapter::SizeType
+OscarSearchSgIndex::position(const std::string& qs, const sserialize::StringCompleter::QuerryType qt) const {
 	std::string qstr;
 	if (m_sq & sserialize::StringCompleter::SQ_CASE_INSENSITIVE) {
 		qstr = sserialize::unicode_to_lower(qs);
@@ -72,38 +159,223 @@ OscarSearchSgIndex::typeFromCompletion(const std::string& qs, const sserialize::
 	else {
 		qstr = qs;
 	}
-	auto pos = m_trie.find(qstr, (qt & sserialize::StringCompleter::QT_SUBSTRING || qt & sserialize::StringCompleter::QT_PREFIX));
-	
-	if (pos == m_trie.npos) {
-		throw sserialize::OutOfBoundsException("OscarSearchSgIndex::typeFromCompletion");
-	}
-	
-	Payload p( pd.at(pos) );
-	Payload::Type t;
-	if (p.types() & qt) {
-		t = p.type(qt);
+	return m_trie.find(qstr, (qt & sserialize::StringCompleter::QT_SUBSTRING || qt & sserialize::StringCompleter::QT_PREFIX));
+}
+
+OscarSearchSgIndex::Payloads const &
+OscarSearchSgIndex::payloads(PayloadSource source) const {
+	switch (source) {
+	case PS_ITEMS:
+		return m_items;
+	case PS_REGIONS:
+		return m_regions;
+	case PS_MIXED:
+	default:
+		return m_mixed;
+	};
+}
+
+OscarSearchSgIndex::Payload::Type
+OscarSearchSgIndex::typeFromPayload(Payload const & p, const sserialize::StringCompleter::QuerryType qt) {
+	return p.type(payloadQueryType(p.types(), qt));
+}
+
+sserialize::StringCompleter::QuerryType
+OscarSearchSgIndex::payloadQueryType(int types, const sserialize::StringCompleter::QuerryType qt) {
+	if (types & qt) {
+		return qt;
 	}
 	else if (qt & sserialize::StringCompleter::QT_SUBSTRING) {
-		if (p.types() & sserialize::StringCompleter::QT_PREFIX) { //exact suffix matches are either available or not
-			t = p.type(sserialize::StringCompleter::QT_PREFIX);
+		if (types & sserialize::StringCompleter::QT_PREFIX) { //exact suffix matches are either available or not
+			return sserialize::StringCompleter::QT_PREFIX;
 		}
-		else if (p.types() & sserialize::StringCompleter::QT_SUFFIX) {
-			t = p.type(sserialize::StringCompleter::QT_SUFFIX);
+		else if (types & sserialize::StringCompleter::QT_SUFFIX) {
+			return sserialize::StringCompleter::QT_SUFFIX;
 		}
-		else if (p.types() & sserialize::StringCompleter::QT_EXACT) {
-			t = p.type(sserialize::StringCompleter::QT_EXACT);
+		else if (types & sserialize::StringCompleter::QT_EXACT) {
+			return sserialize::StringCompleter::QT_EXACT;
+		}
+	}
+	else if (types & sserialize::StringCompleter::QT_EXACT) { //qt is either prefix, suffix, exact
+		return sserialize::StringCompleter::QT_EXACT;
+	}
+	throw sserialize::OutOfBoundsException("OscarSearchSgIndex::typeFromCompletion");
+}
+
+uint32_t
+OscarSearchSgIndex::cellCount(const std::string& qs, const sserialize::StringCompleter::QuerryType qt, Payloads const & pd) const {
+	try {
+		Payload::Type t(typeFromCompletion(qs, qt, pd));
+		return idxStore().idxSize(t.fmPtr()) + idxStore().idxSize(t.pPtr());
+	}
+	catch (const sserialize::OutOfBoundsException & e) {
+		return 0;
+	}
+}
+
+uint32_t
+OscarSearchSgIndex::completeCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const {
+	return cellCount(qstr, qt, m_mixed);
+}
+
+uint32_t
+OscarSearchSgIndex::itemsCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const {
+	return cellCount(qstr, qt, m_items);
+}
+
+uint32_t
+OscarSearchSgIndex::regionsCellCount(const std::string & qstr, const sserialize::StringCompleter::QuerryType qt) const {
+	return cellCount(qstr, qt, m_regions);
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::cellIds(std::vector<sserialize::spatial::dgg::interface::SpatialGrid::PixelId> const & pixels) const {
+	std::vector<uint32_t> result;
+	result.reserve(pixels.size());
+	for(auto pixel : pixels) {
+		if (sg().level(pixel) >= sg().defaultLevel()) {
+			if (sgInfo().hasSgIndex(pixel)) {
+				result.push_back(sgInfo().cPixelId(pixel));
+			}
 		}
 		else {
-			throw sserialize::OutOfBoundsException("OscarSearchSgIndex::typeFromCompletion");
+			sgCells()->cellIds(pixel, result);
 		}
 	}
-	else if (p.types() & sserialize::StringCompleter::QT_EXACT) { //qt is either prefix, suffix, exact
-		t = p.type(sserialize::StringCompleter::QT_EXACT);
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+std::shared_ptr<hic::SpatialGridCells const> const &
+OscarSearchSgIndex::sgCells() const {
+	std::call_once(m_sgCellsFlag, [this]() {
+		m_sgCells = std::make_shared<hic::SpatialGridCells>(m_sg, m_sgInfo);
+	});
+	return m_sgCells;
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::nearCellIds(std::vector<uint32_t> const & cellIds, double distance, bool withSource) const {
+	if (!cellIds.size()) {
+		return cellIds;
 	}
-	else {
-		throw sserialize::OutOfBoundsException("OscarSearchSgIndex::typeFromCompletion");
+	hic::SpatialGridCoverer coverer(sg());
+	std::vector<hic::SpatialGridCoverer::PixelId> pixels;
+	pixels.reserve(cellIds.size());
+	for(uint32_t cellId : cellIds) {
+		pixels.push_back(sgInfo().sgIndex(cellId));
 	}
-	return t;
+	//NEAR with a distance of 0 still means touching cells.
+	//Cells differ in size, hence the smallest one determines the number of rounds
+	uint32_t rounds = std::max<uint32_t>(withSource ? 1 : 0, coverer.rounds(pixels, distance));
+	std::vector<uint32_t> result = this->cellIds(coverer.dilate(pixels, rounds));
+	if (!withSource) {
+		std::vector<uint32_t> tmp;
+		std::set_difference(result.begin(), result.end(), cellIds.begin(), cellIds.end(), std::back_inserter(tmp));
+		result = std::move(tmp);
+	}
+	return result;
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::cellIds(sserialize::CellQueryResult const & cqr) {
+	std::vector<uint32_t> result;
+	result.reserve(cqr.cellCount());
+	for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+		result.push_back(cqr.cellId(i));
+	}
+	return result;
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::cellIds(sserialize::TreedCellQueryResult const & cqr) {
+	return cellIds(cqr.toCQR());
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::regionStoreIds(sserialize::ItemIndex const & items) const {
+	std::vector<uint32_t> result;
+	if (!hasRegionCells()) {
+		return result;
+	}
+	for(uint32_t itemId : items) {
+		if (m_regionStoreIds.contains(itemId)) {
+			result.push_back(itemId);
+		}
+	}
+	return result;
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::regionStoreIds(sserialize::CellQueryResult const & cqr) const {
+	std::vector<uint32_t> result;
+	if (!hasRegionCells()) {
+		return result;
+	}
+	//Full-match cells yield the index of the cell, partial-match cells their own index
+	for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+		for(uint32_t itemId : cqr.idx(i)) {
+			if (m_regionStoreIds.contains(itemId)) {
+				result.push_back(itemId);
+			}
+		}
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::regionStoreIds(sserialize::TreedCellQueryResult const & cqr) const {
+	return regionStoreIds(cqr.toCQR());
+}
+
+bool
+OscarSearchSgIndex::isRegion(uint32_t itemId) const {
+	return hasRegionCells() && m_regionStoreIds.contains(itemId);
+}
+
+std::vector<uint32_t>
+OscarSearchSgIndex::itemCellIds(uint32_t itemId) const {
+	if (!hasItemCells()) {
+		throw sserialize::UnsupportedFeatureException("OscarSearchSgIndex: index has no item cells");
+	}
+	std::vector<uint32_t> result;
+	if (itemId+1 >= m_itemCellsBegin.size()) {
+		return result;
+	}
+	for(uint32_t i(m_itemCellsBegin.at(itemId)), s(m_itemCellsBegin.at(itemId+1)); i < s; ++i) {
+		result.push_back(m_itemCells.at(i));
+	}
+	return result;
+}
+
+sserialize::ItemIndex
+OscarSearchSgIndex::flaten(sserialize::CellQueryResult const & cqr) {
+	return cqr.flaten();
+}
+
+sserialize::ItemIndex
+OscarSearchSgIndex::flaten(sserialize::TreedCellQueryResult const & cqr) {
+	return cqr.toCQR().flaten();
+}
+
+uint32_t
+OscarSearchSgIndex::minItemId(sserialize::CellQueryResult const & cqr) {
+	uint32_t result = std::numeric_limits<uint32_t>::max();
+	for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+		sserialize::ItemIndex idx = cqr.idx(i);
+		if (idx.size()) {
+			result = std::min(result, idx.front());
+		}
+	}
+	return result;
+}
+
+uint32_t
+OscarSearchSgIndex::minItemId(sserialize::TreedCellQueryResult const & cqr) {
+	return minItemId(cqr.toCQR());
 }
 
 //BEGIN HCQROscarCellIndex
@@ -145,6 +417,11 @@ HCQROscarCellIndex::region(uint32_t regionId) const {
 	return m_base->region<CellQueryResult>(regionId);
 }
 
+HCQROscarCellIndex::CellQueryResult
+HCQROscarCellIndex::item(uint32_t itemId) const {
+	return m_base->item<CellQueryResult>(itemId);
+}
+
 
 //END
 
@@ -154,6 +431,148 @@ SgOpTree::SgOpTree(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> con
 m_d(d)
 {}
 
+const SgOpTree::Node *
+SgOpTree::refinableLeaf() const {
+	const Node * node = root();
+	while (node && node->baseType == Node::BINARY_OP && node->subType == Node::SET_OP && setOp(node) == '/') {
+		node = node->children.back();
+	}
+	if (node && node->baseType == Node::LEAF && (node->subType == Node::STRING || node->subType == Node::STRING_ITEM || node->subType == Node::STRING_REGION)) {
+		return node;
+	}
+	return 0;
+}
+
+bool
+SgOpTree::refines(const Node * prev, const Node * leaf) {
+	if (!prev || !leaf || prev->subType != leaf->subType) {
+		return false;
+	}
+	std::string pstr(prev->value);
+	std::string lstr(leaf->value);
+	auto pqt = sserialize::StringCompleter::normalize(pstr);
+	auto lqt = sserialize::StringCompleter::normalize(lstr);
+	if (pqt != lqt || !pstr.size() || lstr.size() <= pstr.size()) {
+		return false;
+	}
+	if (pqt == sserialize::StringCompleter::QT_PREFIX || pqt == sserialize::StringCompleter::QT_SUBSTRING) {
+		return lstr.compare(0, pstr.size(), pstr) == 0;
+	}
+	return false;
+}
+
+void
+SgOpTree::leaves(std::vector<const Node*> & dest) const {
+	std::vector<const Node*> stack;
+	if (root()) {
+		stack.push_back(root());
+	}
+	while (stack.size()) {
+		const Node * node = stack.back();
+		stack.pop_back();
+		if (node->baseType == Node::LEAF) {
+			dest.push_back(node);
+		}
+		for(const Node * child : node->children) {
+			if (child) {
+				stack.push_back(child);
+			}
+		}
+	}
+}
+
+void
+SgOpTree::clip(sserialize::spatial::GeoRect const & rect) {
+	m_clip = std::make_unique<sserialize::spatial::GeoRect>(rect);
+}
+
+std::string
+SgOpTree::canonicalKey() const {
+	KeyMap keys;
+	return canonicalKey(root(), keys);
+}
+
+std::string const &
+SgOpTree::canonicalKey(const Node * node, KeyMap & keys) {
+	auto it = keys.find(node);
+	if (it != keys.end()) {
+		return it->second;
+	}
+	//values are length prefixed since they may contain any character
+	auto valueKey = [](const Node * node) -> std::string {
+		return std::to_string(node->subType) + ":" + std::to_string(node->value.size()) + ":" + node->value;
+	};
+	std::string key;
+	if (!node) {
+		key = "()";
+	}
+	else if (node->baseType == Node::LEAF) {
+		key = "L" + valueKey(node);
+	}
+	else if (node->baseType == Node::UNARY_OP) {
+		key = "U" + valueKey(node) + "(" + canonicalKey(node->children.at(0), keys) + ")";
+	}
+	else if (isCommutativeSetOp(node)) {
+		std::vector<const Node*> ops;
+		operands(node, setOp(node), ops);
+		std::vector<std::string> opKeys;
+		for(const Node * op : ops) {
+			opKeys.emplace_back(canonicalKey(op, keys));
+		}
+		std::sort(opKeys.begin(), opKeys.end());
+		key = "S";
+		key += setOp(node);
+		key += "(";
+		for(std::size_t i(0), s(opKeys.size()); i < s; ++i) {
+			if (i) {
+				key += ",";
+			}
+			key += opKeys[i];
+		}
+		key += ")";
+	}
+	else {
+		key = "B" + valueKey(node) + "(";
+		for(std::size_t i(0), s(node->children.size()); i < s; ++i) {
+			if (i) {
+				key += ",";
+			}
+			key += canonicalKey(node->children[i], keys);
+		}
+		key += ")";
+	}
+	return keys.emplace(node, std::move(key)).first->second;
+}
+
+char
+SgOpTree::setOp(const Node * node) {
+	if (!node || node->baseType != Node::BINARY_OP || node->subType != Node::SET_OP || node->value.empty()) {
+		return 0;
+	}
+	if (node->value.at(0) == ' ') {
+		return '/';
+	}
+	return node->value.at(0);
+}
+
+bool
+SgOpTree::isCommutativeSetOp(const Node * node) {
+	char op = setOp(node);
+	return op == '+' || op == '/';
+}
+
+void
+SgOpTree::operands(const Node * node, char op, std::vector<const Node*> & dest) {
+	if (setOp(node) == op) {
+		for(const Node * child : node->children) {
+			operands(child, op, dest);
+		}
+	}
+	else {
+		dest.push_back(node);
+	}
+}
+
 
 
 //END SgOpTree
@@ -196,6 +615,100 @@ OscarSearchSgIndexCellInfo::cellItemsPtr(CellId cellId) const {
 }//end namespace detail
 //END Static::detail::OscarSearchSgIndexCellInfo
 
+//BEGIN Static::detail::CellQueryResultItemMerger
+namespace detail {
+
+CellQueryResultItemMerger::CellQueryResultItemMerger(sserialize::CellQueryResult const & cqr) :
+m_cqr(cqr)
+{}
+
+CellQueryResultItemMerger::~CellQueryResultItemMerger() {}
+
+void
+CellQueryResultItemMerger::init() const {
+	m_cursors.reserve(m_cqr.cellCount());
+	for(uint32_t i(0), s(m_cqr.cellCount()); i < s; ++i) {
+		m_cursors.emplace_back();
+		Cursor & c = m_cursors.back();
+		c.idx = m_cqr.idx(i);
+		c.it = c.idx.cbegin();
+		c.end = c.idx.cend();
+		if (c.it != c.end) {
+			m_heap.emplace_back(*c.it, m_cursors.size()-1);
+		}
+		else { //nothing to keep of empty cells
+			m_cursors.pop_back();
+		}
+	}
+	std::make_heap(m_heap.begin(), m_heap.end(), &heapCmp);
+	m_cqr = sserialize::CellQueryResult();
+}
+
+void
+CellQueryResultItemMerger::next() {
+	uint32_t cur = get();
+	//items spanning multiple cells are on top of the heap multiple times
+	while (m_heap.size() && m_heap.front().first == cur) {
+		std::pop_heap(m_heap.begin(), m_heap.end(), &heapCmp);
+		std::size_t cursor = m_heap.back().second;
+		m_heap.pop_back();
+		advance(cursor);
+	}
+}
+
+void
+CellQueryResultItemMerger::advance(std::size_t cursor) {
+	Cursor & c = m_cursors[cursor];
+	++c.it;
+	if (c.it != c.end) {
+		m_heap.emplace_back(*c.it, cursor);
+		std::push_heap(m_heap.begin(), m_heap.end(), &heapCmp);
+	}
+	else { //free the index data early
+		c.idx = sserialize::ItemIndex();
+	}
+}
+
+}//end namespace detail
+//END Static::detail::CellQueryResultItemMerger
+
+//BEGIN CellQueryResultItemIterator
+
+CellQueryResultItemIterator::CellQueryResultItemIterator() {}
+
+CellQueryResultItemIterator::CellQueryResultItemIterator(sserialize::CellQueryResult const & cqr) :
+m_d(std::make_shared<detail::CellQueryResultItemMerger>(cqr))
+{}
+
+CellQueryResultItemIterator::~CellQueryResultItemIterator() {}
+
+bool
+CellQueryResultItemIterator::valid() const {
+	return m_d && m_d->valid();
+}
+
+uint32_t
+CellQueryResultItemIterator::operator*() const {
+	return m_d->get();
+}
+
+CellQueryResultItemIterator &
+CellQueryResultItemIterator::operator++() {
+	m_d->next();
+	return *this;
+}
+
+uint32_t
+CellQueryResultItemIterator::skip(uint32_t count) {
+	uint32_t result = 0;
+	for(; result < count && valid(); ++result) {
+		m_d->next();
+	}
+	return result;
+}
+
+//END CellQueryResultItemIterator
+
 //BEGIN OscarSearchSgCompleter
 
 void
@@ -207,19 +720,321 @@ OscarSearchSgCompleter::energize(std::string const & files) {
 }
 
 sserialize::CellQueryResult
-OscarSearchSgCompleter::complete(std::string const & str, bool treedCqr, uint32_t threadCount) {
+OscarSearchSgCompleter::complete(std::string const & str, bool treedCqr, uint32_t threadCount, hic::Deadline const & deadline) {
 	SgOpTree opTree(m_d);
 	opTree.parse(str);
+	opTree.deadline(deadline);
 	if (treedCqr) {
-		return opTree.calc<sserialize::TreedCellQueryResult>().toCQR(threadCount);
+		return opTree.calc<sserialize::TreedCellQueryResult>(threadCount).toCQR(threadCount);
 	}
 	else {
-		return opTree.calc<sserialize::CellQueryResult>();
+		return opTree.calc<sserialize::CellQueryResult>(threadCount);
 	}
 }
 
+uint32_t
+OscarSearchSgCompleter::count(std::string const & str, CountMode cm, uint32_t threadCount, hic::Deadline const & deadline) {
+	return count(complete(str, false, threadCount, deadline), cm, deadline);
+}
+
+sserialize::CellQueryResult
+OscarSearchSgCompleter::complete(std::string const & str, sserialize::spatial::GeoRect const & viewport, bool treedCqr, uint32_t threadCount, hic::Deadline const & deadline) {
+	SgOpTree opTree(m_d);
+	opTree.parse(str);
+	opTree.clip(viewport);
+	opTree.deadline(deadline);
+	if (treedCqr) {
+		return opTree.calc<sserialize::TreedCellQueryResult>(threadCount).toCQR(threadCount);
+	}
+	else {
+		return opTree.calc<sserialize::CellQueryResult>(threadCount);
+	}
+}
+
+CellQueryResultItemIterator
+OscarSearchSgCompleter::iterate(std::string const & str, uint32_t threadCount) {
+	return CellQueryResultItemIterator(complete(str, false, threadCount));
+}
+
+std::vector<uint32_t>
+OscarSearchSgCompleter::items(std::string const & str, uint32_t offset, uint32_t limit, uint32_t threadCount) {
+	std::vector<uint32_t> result;
+	CellQueryResultItemIterator it = iterate(str, threadCount);
+	it.skip(offset);
+	it.take(limit, std::back_inserter(result));
+	return result;
+}
+
+uint32_t
+OscarSearchSgCompleter::count(sserialize::CellQueryResult const & cqr, CountMode cm, hic::Deadline const & deadline) const {
+	uint32_t result = 0;
+	if (cm == CM_ESTIMATE) {
+		for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+			if (cqr.fullMatch(i)) {
+				result += index().idxStore().idxSize( index().sgInfo().itemIndexId(cqr.cellId(i)) );
+			}
+			else {
+				result += cqr.idxSize(i);
+			}
+		}
+	}
+	else {
+		for(CellQueryResultItemIterator it(cqr); it.valid(); ++it) {
+			++result;
+			if ((result & 0xFFF) == 0) {
+				deadline.check("OscarSearchSgCompleter::count");
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<hic::PixelCount>
+OscarSearchSgCompleter::heatmap(sserialize::CellQueryResult const & cqr, uint32_t level) const {
+	auto const & sg = index().sg();
+	auto const & sgInfo = index().sgInfo();
+	PixelCounts counts;
+	for(uint32_t i(0), s(cqr.cellCount()); i < s; ++i) {
+		uint32_t cellId = cqr.cellId(i);
+		uint32_t count = cqr.fullMatch(i) ? index().idxStore().idxSize( sgInfo.itemIndexId(cellId) ) : cqr.idxSize(i);
+		if (count) {
+			addPixelCount(sg, sgInfo.sgIndex(cellId), level, count, counts);
+		}
+	}
+	return sortedPixelCounts(counts);
+}
+
+std::vector<OscarSearchSgCompleter::Neighbour>
+OscarSearchSgCompleter::knn(std::string const & str, double lat, double lon, uint32_t k, ItemDistance const & distance, uint32_t threadCount) {
+	return knn(complete(str, false, threadCount), lat, lon, k, distance);
+}
+
+std::vector<OscarSearchSgCompleter::Neighbour>
+OscarSearchSgCompleter::knn(sserialize::CellQueryResult const & cqr, double lat, double lon, uint32_t k, ItemDistance const & distance) const {
+	using PixelId = hic::SpatialGridCoverer::PixelId;
+	auto cmp = [](Neighbour const & a, Neighbour const & b) {
+		return a.distance < b.distance || (a.distance == b.distance && a.itemId < b.itemId);
+	};
+	std::vector<Neighbour> result;
+	if (!k || !cqr.cellCount()) {
+		return result;
+	}
+	auto const & sg = index().sg();
+	auto const & sgInfo = index().sgInfo();
+	hic::SpatialGridCoverer coverer(sg);
+	sserialize::spatial::GeoPoint point(lat, lon);
+	
+	std::vector<uint32_t> cqrCellIds = OscarSearchSgIndex::cellIds(cqr);
+	uint32_t remainingCells = cqrCellIds.size();
+	std::unordered_set<uint32_t> seenItems;
+	//max-heap of the best k items
+	std::vector<Neighbour> heap;
+	
+	std::unordered_set<PixelId> visited;
+	std::vector<PixelId> ring(1, sg.index(lat, lon));
+	visited.insert(ring.front());
+	while (ring.size() && remainingCells) {
+		for(PixelId pixel : ring) {
+			if (!sgInfo.hasSgIndex(pixel)) {
+				continue;
+			}
+			uint32_t cellId = sgInfo.cPixelId(pixel);
+			auto it = std::lower_bound(cqrCellIds.begin(), cqrCellIds.end(), cellId);
+			if (it == cqrCellIds.end() || *it != cellId) {
+				continue;
+			}
+			--remainingCells;
+			for(uint32_t itemId : cqr.idx(it - cqrCellIds.begin())) {
+				if (!seenItems.insert(itemId).second) {
+					continue;
+				}
+				Neighbour n{itemId, distance(itemId)};
+				if (heap.size() < k) {
+					heap.push_back(n);
+					std::push_heap(heap.begin(), heap.end(), cmp);
+				}
+				else if (cmp(n, heap.front())) {
+					std::pop_heap(heap.begin(), heap.end(), cmp);
+					heap.back() = n;
+					std::push_heap(heap.begin(), heap.end(), cmp);
+				}
+			}
+		}
+		std::vector<PixelId> nextRing;
+		double nextDistance = std::numeric_limits<double>::max();
+		for(PixelId pixel : ring) {
+			for(PixelId n : coverer.neighbours(pixel)) {
+				if (visited.insert(n).second) {
+					nextRing.push_back(n);
+					nextDistance = std::min(nextDistance, hic::SpatialGridCoverer::distance(point, sg.bbox(n)));
+				}
+			}
+		}
+		if (heap.size() == k && heap.front().distance <= nextDistance) {
+			break;
+		}
+		ring = std::move(nextRing);
+	}
+	std::sort_heap(heap.begin(), heap.end(), cmp);
+	return heap;
+}
+
+OscarSearchSgCompleterSession
+OscarSearchSgCompleter::session() const {
+	return OscarSearchSgCompleterSession(m_d);
+}
+
+std::vector<sserialize::CellQueryResult>
+OscarSearchSgCompleter::complete(std::vector<std::string> const & strs, uint32_t threadCount) {
+	using CQRType = sserialize::CellQueryResult;
+	using Node = SgOpTree::Node;
+	struct Leaf {
+		uint32_t tree;
+		const Node * node;
+		std::string key;
+		///subType and normalized query string, leaves sorted by this are resolved in trie order
+		std::pair<int, std::string> order;
+	};
+	threadCount = std::max<uint32_t>(threadCount, 1);
+	
+	std::vector<std::unique_ptr<SgOpTree>> trees;
+	std::vector<Leaf> leaves;
+	{
+		std::unordered_set<std::string> seen;
+		for(uint32_t i(0), s(strs.size()); i < s; ++i) {
+			trees.emplace_back(std::make_unique<SgOpTree>(m_d));
+			trees.back()->parse(strs[i]);
+			std::vector<const Node*> nodes;
+			SgOpTree::KeyMap keys;
+			trees.back()->leaves(nodes);
+			for(const Node * node : nodes) {
+				std::string const & key = SgOpTree::canonicalKey(node, keys);
+				if (seen.count(key)) {
+					continue;
+				}
+				seen.insert(key);
+				Leaf leaf{i, node, key, std::make_pair(int(node->subType), node->value)};
+				if (node->subType == Node::STRING || node->subType == Node::STRING_ITEM || node->subType == Node::STRING_REGION) {
+					sserialize::StringCompleter::normalize(leaf.order.second);
+				}
+				leaves.emplace_back(std::move(leaf));
+			}
+		}
+	}
+	std::sort(leaves.begin(), leaves.end(), [](Leaf const & a, Leaf const & b) {
+		return a.order < b.order;
+	});
+	
+	//Every thread resolves consecutive blocks of leaves
+	std::vector<CQRType> leafResults(leaves.size());
+	{
+		std::size_t blockSize = std::max<std::size_t>(1, leaves.size()/(4*threadCount));
+		std::atomic<std::size_t> next{0};
+		sserialize::ThreadPool::execute([&]() {
+			while (true) {
+				std::size_t begin = next.fetch_add(blockSize, std::memory_order_relaxed);
+				if (begin >= leaves.size()) {
+					return;
+				}
+				//String leaves of a block are resolved together to overlap their data accesses
+				std::vector<OscarSearchSgIndex::StringQuery> queries;
+				std::vector<std::size_t> queryLeaves;
+				for(std::size_t i(begin), s(std::min(begin+blockSize, leaves.size())); i < s; ++i) {
+					const Node * node = leaves[i].node;
+					if (node->value.size() && (node->subType == Node::STRING || node->subType == Node::STRING_ITEM || node->subType == Node::STRING_REGION)) {
+						OscarSearchSgIndex::PayloadSource source = OscarSearchSgIndex::PS_MIXED;
+						if (node->subType == Node::STRING_ITEM) {
+							source = OscarSearchSgIndex::PS_ITEMS;
+						}
+						else if (node->subType == Node::STRING_REGION) {
+							source = OscarSearchSgIndex::PS_REGIONS;
+						}
+						std::string qstr(node->value);
+						auto qt = sserialize::StringCompleter::normalize(qstr);
+						queries.push_back(OscarSearchSgIndex::StringQuery{std::move(qstr), qt, source});
+						queryLeaves.push_back(i);
+					}
+					else {
+						leafResults[i] = trees[leaves[i].tree]->calc<CQRType>(node, 1);
+					}
+				}
+				std::vector<CQRType> queryResults = m_d->complete<CQRType>(queries);
+				for(std::size_t i(0), s(queryLeaves.size()); i < s; ++i) {
+					leafResults[queryLeaves[i]] = std::move(queryResults[i]);
+				}
+			}
+		}, threadCount, sserialize::ThreadPool::CopyTaskTag());
+	}
+	SgOpTree::ResultCache<CQRType> cache;
+	for(std::size_t i(0), s(leaves.size()); i < s; ++i) {
+		cache.emplace(std::move(leaves[i].key), std::move(leafResults[i]));
+	}
+	
+	std::vector<CQRType> result(strs.size());
+	{
+		std::atomic<std::size_t> next{0};
+		sserialize::ThreadPool::execute([&]() {
+			while (true) {
+				std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+				if (i >= trees.size()) {
+					return;
+				}
+				result[i] = trees[i]->calc<CQRType>(cache, 1);
+			}
+		}, threadCount, sserialize::ThreadPool::CopyTaskTag());
+	}
+	return result;
+}
+
 //END OscarSearchSgCompleter
 
+//BEGIN OscarSearchSgCompleterSession
+
+OscarSearchSgCompleterSession::OscarSearchSgCompleterSession(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d) :
+m_d(d)
+{}
+
+OscarSearchSgCompleterSession::~OscarSearchSgCompleterSession() {}
+
+sserialize::CellQueryResult
+OscarSearchSgCompleterSession::complete(std::string const & str, uint32_t threadCount) {
+	SgOpTree opTree(m_d);
+	opTree.parse(str);
+	m_refined = false;
+	//Only plain characters may be appended, anything else may change the structure of the query
+	auto isPlain = [](char c) {
+		return (unsigned char)(c) >= 0x80 || std::isalnum((unsigned char)(c));
+	};
+	if (m_valid && str.size() > m_str.size() && str.compare(0, m_str.size(), m_str) == 0 &&
+		std::all_of(str.begin()+m_str.size(), str.end(), isPlain))
+	{
+		SgOpTree prevTree(m_d);
+		prevTree.parse(m_str);
+		const SgOpTree::Node * leaf = opTree.refinableLeaf();
+		const SgOpTree::Node * prevLeaf = prevTree.refinableLeaf();
+		if (leaf && prevLeaf && leaf->value == prevLeaf->value + str.substr(m_str.size()) && SgOpTree::refines(prevLeaf, leaf)) {
+			m_cqr = m_cqr / opTree.calc<sserialize::CellQueryResult>(leaf, threadCount);
+			m_refined = true;
+		}
+	}
+	if (!m_refined) {
+		m_cqr = opTree.calc<sserialize::CellQueryResult>(threadCount);
+	}
+	m_str = str;
+	m_valid = true;
+	return m_cqr;
+}
+
+void
+OscarSearchSgCompleterSession::reset() {
+	m_valid = false;
+	m_refined = false;
+	m_str.clear();
+	m_cqr = sserialize::CellQueryResult();
+}
+
+//END OscarSearchSgCompleterSession
+
 //BEGIN HCQROscarSearchSgCompleter
 
 
@@ -243,8 +1058,242 @@ makeOscarSearchSgHCQRIndex(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIn
 	return uncachedIndex;
 }
 
+sserialize::RCPtrWrapper<hic::interface::HcqrSpatialOps>
+makeOscarSearchSgHCQRSpatialOps(sserialize::RCPtrWrapper<hic::Static::OscarSearchSgIndex> const & d) {
+	return sserialize::RCPtrWrapper<hic::interface::HcqrSpatialOps>( new HCQROscarSpatialOps(d) );
+}
+
 //END HCQROscarSearchSgCompleter
 
+//BEGIN HCQROscarSpatialOps
+
+HCQROscarSpatialOps::HCQROscarSpatialOps(sserialize::RCPtrWrapper<OscarSearchSgIndex> const & base) :
+m_base(base)
+{
+	using SpatialGridInfoImp = sserialize::spatial::dgg::detail::HCQRIndexFromCellIndex::impl::SpatialGridInfoFromCellIndexWithIndex;
+	using HCQRCellInfo = sserialize::spatial::dgg::Static::HCQRTextIndex::HCQRCellInfo;
+	auto cellInfoPtr = sserialize::RCPtrWrapper<HCQRCellInfo>( new HCQRCellInfo(m_base->idxStore(), m_base->sgInfoPtr()) );
+	m_sgi.reset( new SpatialGridInfoImp(m_base->sgPtr(), cellInfoPtr) );
+}
+
+HCQROscarSpatialOps::~HCQROscarSpatialOps() {}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::polygon(std::vector<sserialize::spatial::GeoPoint> const & points) const {
+	return toHCQR(m_base->polygon<sserialize::CellQueryResult>(points));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::path(double radius, std::vector<sserialize::spatial::GeoPoint> const & points) const {
+	return toHCQR(m_base->path<sserialize::CellQueryResult>(radius, points));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::near(HCQRPtr const & hcqr, double distance, bool withSource) const {
+	using HCQRSpatialGrid = sserialize::spatial::dgg::impl::HCQRSpatialGrid;
+	auto sghcqr = dynamic_cast<HCQRSpatialGrid const *>(hcqr.get());
+	if (!sghcqr) {
+		throw sserialize::UnsupportedFeatureException("HCQROscarSpatialOps::near: unsupported hcqr type");
+	}
+	std::vector<hic::SpatialGridCoverer::PixelId> pixels;
+	std::vector<HCQRSpatialGrid::TreeNode const *> stack;
+	if (sghcqr->root()) {
+		stack.push_back(sghcqr->root().get());
+	}
+	while (stack.size()) {
+		HCQRSpatialGrid::TreeNode const * node = stack.back();
+		stack.pop_back();
+		if (node->children().size()) {
+			for(auto const & child : node->children()) {
+				stack.push_back(child.get());
+			}
+		}
+		else {
+			//compactified leaves may be above the level of the cells, cellIds() resolves them to the cells below
+			pixels.push_back(node->pixelId());
+		}
+	}
+	std::vector<uint32_t> cellIds = m_base->nearCellIds(m_base->cellIds(pixels), distance, withSource);
+	return toHCQR(m_base->fullMatchCells<sserialize::CellQueryResult>(cellIds));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::item(uint32_t itemId) const {
+	return toHCQR(m_base->item<sserialize::CellQueryResult>(itemId));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::relevantElement(HCQRPtr const & hcqr) const {
+	//Item indexes are sorted, hence the smallest item is the minimum of the first items of the leaves
+	uint32_t itemId = std::numeric_limits<uint32_t>::max();
+	leafItems(hcqr, [&itemId](sserialize::ItemIndex const & idx) {
+		if (idx.size()) {
+			itemId = std::min(itemId, idx.front());
+		}
+	});
+	if (itemId == std::numeric_limits<uint32_t>::max()) {
+		return toHCQR(m_base->fullMatchCells<sserialize::CellQueryResult>(std::vector<uint32_t>()));
+	}
+	if (m_base->isRegion(itemId)) {
+		return toHCQR(m_base->region<sserialize::CellQueryResult>(itemId).allToFull());
+	}
+	return toHCQR(m_base->fullMatchCells<sserialize::CellQueryResult>(m_base->itemCellIds(itemId)));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::in(HCQRPtr const & hcqr) const {
+	std::vector<uint32_t> storeIds;
+	leafItems(hcqr, [this, &storeIds](sserialize::ItemIndex const & idx) {
+		for(uint32_t itemId : idx) {
+			if (m_base->isRegion(itemId)) {
+				storeIds.push_back(itemId);
+			}
+		}
+	});
+	std::sort(storeIds.begin(), storeIds.end());
+	storeIds.erase(std::unique(storeIds.begin(), storeIds.end()), storeIds.end());
+	return toHCQR(m_base->regions<sserialize::CellQueryResult>(storeIds));
+}
+
+void
+HCQROscarSpatialOps::leafItems(HCQRPtr const & hcqr, std::function<void(sserialize::ItemIndex const &)> const & f) const {
+	using HCQRSpatialGrid = sserialize::spatial::dgg::impl::HCQRSpatialGrid;
+	auto sghcqr = dynamic_cast<HCQRSpatialGrid const *>(hcqr.get());
+	if (!sghcqr) {
+		f(hcqr->items());
+		return;
+	}
+	auto const & sgInfo = m_base->sgInfo();
+	auto const & idxStore = m_base->idxStore();
+	std::vector<uint32_t> cellIds;
+	std::vector<HCQRSpatialGrid::TreeNode const *> stack;
+	if (sghcqr->root()) {
+		stack.push_back(sghcqr->root().get());
+	}
+	while (stack.size()) {
+		HCQRSpatialGrid::TreeNode const * node = stack.back();
+		stack.pop_back();
+		if (node->children().size()) {
+			for(auto const & child : node->children()) {
+				stack.push_back(child.get());
+			}
+		}
+		else if (node->isFullMatch()) {
+			cellIds.clear();
+			m_base->sgCells()->cellIds(node->pixelId(), cellIds);
+			for(uint32_t cellId : cellIds) {
+				f(idxStore.at(sgInfo.itemIndexId(cellId)));
+			}
+		}
+		else {
+			f(node->isFetched() ? sghcqr->items(*node) : idxStore.at(node->itemIndexId()));
+		}
+	}
+}
+
+std::vector<HCQROscarSpatialOps::HCQRPtr> const &
+HCQROscarSpatialOps::rootRegions() const {
+	std::call_once(m_rootRegionsFlag, [this]() {
+		using PixelId = sserialize::spatial::dgg::interface::SpatialGrid::PixelId;
+		auto const & sg = m_base->sg();
+		auto const & sgInfo = m_base->sgInfo();
+		auto root = sg.rootPixelId();
+		std::unordered_map<PixelId, uint32_t> rootChild;
+		for(uint32_t i(0), s(sg.childrenCount(root)); i < s; ++i) {
+			rootChild[sg.index(root, i)] = i;
+		}
+		//Bucket the cells of the index by the child of the root they are in.
+		//Cell ids are visited in ascending order, hence every bucket is sorted
+		std::vector<std::vector<uint32_t>> buckets(rootChild.size());
+		for(uint32_t cellId(0), s(sgInfo.cPixelCount()); cellId < s; ++cellId) {
+			PixelId pixel = sgInfo.sgIndex(cellId);
+			while (sg.parent(pixel) != root) {
+				pixel = sg.parent(pixel);
+			}
+			buckets.at(rootChild.at(pixel)).push_back(cellId);
+		}
+		//Collapse each bucket to a single node at its root child and make it full-match.
+		//Intersections with a root region then only check the pixel of that node instead of walking a full-depth tree.
+		//Computed once, the items gathered by compactified() are dropped by allToFull()
+		for(uint32_t i(0), s(sg.childrenCount(root)); i < s; ++i) {
+			auto const & cellIds = buckets.at(rootChild.at(sg.index(root, i)));
+			HCQRPtr region = toHCQR(m_base->fullMatchCells<sserialize::CellQueryResult>(cellIds));
+			region = region->compactified(sg.level(sg.index(root, i)));
+			m_rootRegions.emplace_back(region->allToFull());
+		}
+	});
+	return m_rootRegions;
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::rect(sserialize::spatial::GeoRect const & rect) const {
+	return toHCQR(m_base->rect<sserialize::CellQueryResult>(rect));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::cells(std::vector<uint32_t> const & cellIds) const {
+	return toHCQR(m_base->cells<sserialize::CellQueryResult>(cellIds));
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::regionExclusiveCells(uint32_t regionId) const {
+	return toHCQR(m_base->regionExclusiveCells<sserialize::CellQueryResult>(regionId));
+}
+
+std::vector<hic::PixelCount>
+HCQROscarSpatialOps::heatmap(HCQRPtr const & hcqr, uint32_t level) const {
+	using HCQRSpatialGrid = sserialize::spatial::dgg::impl::HCQRSpatialGrid;
+	auto sghcqr = dynamic_cast<HCQRSpatialGrid const *>(hcqr.get());
+	if (!sghcqr) {
+		throw sserialize::UnsupportedFeatureException("HCQROscarSpatialOps::heatmap: unsupported hcqr type");
+	}
+	auto const & sg = m_base->sg();
+	auto const & sgInfo = m_base->sgInfo();
+	auto const & idxStore = m_base->idxStore();
+	auto const & sgCells = *m_base->sgCells();
+	PixelCounts counts;
+	std::vector<uint32_t> cellIds;
+	std::vector<HCQRSpatialGrid::TreeNode const *> stack;
+	if (sghcqr->root()) {
+		stack.push_back(sghcqr->root().get());
+	}
+	while (stack.size()) {
+		HCQRSpatialGrid::TreeNode const * node = stack.back();
+		stack.pop_back();
+		if (node->children().size()) {
+			for(auto const & child : node->children()) {
+				stack.push_back(child.get());
+			}
+		}
+		else if (node->isFullMatch()) {
+			//full-match nodes may be far above the level of the cells, only the indexed cells below them are visited
+			cellIds.clear();
+			sgCells.cellIds(node->pixelId(), cellIds);
+			for(uint32_t cellId : cellIds) {
+				uint32_t count = idxStore.idxSize( sgInfo.itemIndexId(cellId) );
+				if (count) {
+					addPixelCount(sg, sgInfo.sgIndex(cellId), level, count, counts);
+				}
+			}
+		}
+		else {
+			//items of compactified nodes are held by the hcqr itself
+			uint32_t count = node->isFetched() ? sghcqr->items(*node).size() : idxStore.idxSize(node->itemIndexId());
+			if (count) {
+				addPixelCount(sg, node->pixelId(), level, count, counts);
+			}
+		}
+	}
+	return sortedPixelCounts(counts);
+}
+
+HCQROscarSpatialOps::HCQRPtr
+HCQROscarSpatialOps::toHCQR(sserialize::CellQueryResult const & cqr) const {
+	return HCQRPtr( new sserialize::spatial::dgg::impl::HCQRSpatialGrid(cqr, m_base->idxStore(), m_base->sgPtr(), m_sgi) );
+}
+
+//END HCQROscarSpatialOps
+
 //BEGIN OscarSearchHCQRTextIndexCreator
 
 void OscarSearchHCQRTextIndexCreator::run() {
@@ -267,18 +1316,77 @@ void OscarSearchHCQRTextIndexCreator::run() {
 		CellInfo::RCType ci;
 		sserialize::RCPtrWrapper<sserialize::spatial::dgg::Static::HCQRCellInfo> cellInfoPtr;
 		sserialize::RCPtrWrapper<sserialize::spatial::dgg::interface::SpatialGridInfo> sgi;
+		hic::SerializedHcqr::ContextPtr hcqrCtx;
 	};
 	
+	///Serialized trees by the cells and items they were built from, shared by all payload passes.
+	///Trie strings with long unique suffixes and the query types of a string often have the same cells.
+	///Entries are kept until the total size of their keys and trees reaches maxBytes, later trees are not cached.
+	struct PayloadCache {
+		///Position of a tree in a SerializedHcqrTextIndex
+		struct Location {
+			uint8_t source;
+			uint32_t position;
+			uint8_t qt;
+		};
+		struct Entry {
+			///Only set for TF_HCQR_SPATIAL_GRID, other formats refer to the location of the tree
+			sserialize::UByteArrayAdapter data;
+			Location location;
+		};
+		std::unordered_map<std::string, Entry> entries;
+		std::mutex lock;
+		std::size_t maxBytes{0};
+		std::size_t bytes{0};
+		std::atomic<std::size_t> hits{0};
+		std::atomic<std::size_t> misses{0};
+		static std::string key(hic::Static::OscarSearchSgIndex::Payload::Type const & t, sserialize::Static::ItemIndexStore const & idxStore) {
+			std::string result;
+			auto append = [&result](uint32_t v) {
+				result.append(reinterpret_cast<char const *>(&v), sizeof(v));
+			};
+			append(t.fmPtr());
+			append(t.pPtr());
+			auto it = t.pItemsPtrBegin();
+			for(uint32_t i(0), s(idxStore.idxSize(t.pPtr())); i < s; ++i, ++it) {
+				append(*it);
+			}
+			return result;
+		}
+		bool get(std::string const & key, Entry & dest) {
+			std::lock_guard<std::mutex> lck(lock);
+			auto it = entries.find(key);
+			if (it == entries.end()) {
+				misses.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			hits.fetch_add(1, std::memory_order_relaxed);
+			dest = it->second;
+			return true;
+		}
+		void put(std::string && key, Entry const & entry) {
+			std::size_t entryBytes = key.size() + entry.data.size() + sizeof(Entry);
+			std::lock_guard<std::mutex> lck(lock);
+			if (bytes + entryBytes <= maxBytes && entries.emplace(std::move(key), entry).second) {
+				bytes += entryBytes;
+			}
+		}
+	};
+	
+	///One payload pass writing to its own temporary file
 	struct State {
-		sserialize::ProgressInfo pinfo;
 		hic::Static::OscarSearchSgIndex::Payloads const & src;
-		std::atomic<std::size_t> i{0};
-		
+		sserialize::UByteArrayAdapter data;
 		sserialize::Static::ArrayCreator<sserialize::UByteArrayAdapter> ac;
 		std::map<std::size_t, sserialize::UByteArrayAdapter> queue;
+		std::size_t maxPending;
 		std::mutex flushLock;
+		std::condition_variable flushed;
 		void flush(std::size_t i, sserialize::UByteArrayAdapter && d) {
-			std::lock_guard<std::mutex> lck(flushLock);
+			std::unique_lock<std::mutex> lck(flushLock);
+			//Results too far ahead of the next one to write wait for it.
+			//The worker holding the next one never waits, hence this can not deadlock
+			flushed.wait(lck, [this, i]() { return i < ac.size() + maxPending; });
 			if (ac.size() == i) {
 				ac.beginRawPut();
 				ac.rawPut().put(d);
@@ -291,13 +1399,28 @@ void OscarSearchHCQRTextIndexCreator::run() {
 				ac.put(it->second);
 				it = queue.erase(it);
 			}
+			lck.unlock();
+			flushed.notify_all();
 		}
-		State(sserialize::UByteArrayAdapter & dest, hic::Static::OscarSearchSgIndex::Payloads const & src) :
+		State(hic::Static::OscarSearchSgIndex::Payloads const & src, std::size_t maxPending) :
 		src(src),
-		ac(dest)
+		data(sserialize::UByteArrayAdapter::createCache(0, sserialize::MM_FILEBASED)),
+		ac(data),
+		maxPending(std::max<std::size_t>(maxPending, 1))
 		{}
 	};
 	
+	///Progress and work distribution of all passes
+	struct Passes {
+		sserialize::ProgressInfo pinfo;
+		std::vector<std::unique_ptr<State>> states;
+		std::size_t trieSize{0};
+		std::atomic<std::size_t> i{0};
+		///Bytes of the SerializedHcqr trees and of their SuccinctHcqr encoding if TF_SUCCINCT_HCQR is used
+		std::atomic<uint64_t> serializedBytes{0};
+		std::atomic<uint64_t> succinctBytes{0};
+	};
+	
 	struct Worker {
 		std::array<sserialize::StringCompleter::QuerryType, 4> pqt{
 			sserialize::StringCompleter::QT_EXACT,
@@ -346,6 +1469,43 @@ void OscarSearchHCQRTextIndexCreator::run() {
 			return 1;
 		}
 		
+		sserialize::UByteArrayAdapter cachedSge2payload(hic::Static::OscarSearchSgIndex::Payload::Type const & t) {
+			if (!cfg.payloadCacheBytes) {
+				return sge2payload(t);
+			}
+			std::string key = PayloadCache::key(t, cfg.idxStore);
+			PayloadCache::Entry entry;
+			if (!cache.get(key, entry)) {
+				entry.data = sge2payload(t);
+				cache.put(std::move(key), entry);
+			}
+			return entry.data;
+		}
+		
+		///Appends the tree of t written at location or a reference to the same tree written at another location
+		void putSerializedTree(hic::Static::OscarSearchSgIndex::Payload::Type const & t, PayloadCache::Location const & location, sserialize::UByteArrayAdapter & dest) {
+			std::string key;
+			if (cfg.payloadCacheBytes) {
+				key = PayloadCache::key(t, cfg.idxStore);
+				PayloadCache::Entry entry;
+				if (cache.get(key, entry)) {
+					dest.putVlPackedUint32(1);
+					dest.putUint8(entry.location.source);
+					dest.putVlPackedUint32(entry.location.position);
+					dest.putUint8(entry.location.qt);
+					return;
+				}
+			}
+			sserialize::UByteArrayAdapter tree = sge2payload(t);
+			if (cfg.payloadCacheBytes) {
+				PayloadCache::Entry entry;
+				entry.location = location;
+				cache.put(std::move(key), entry);
+			}
+			dest.putVlPackedUint32(tree.size() << 1);
+			dest.put(tree);
+		}
+		
 		sserialize::UByteArrayAdapter sge2payload(hic::Static::OscarSearchSgIndex::Payload::Type const & t) {
 			sserialize::CellQueryResult cqr(
 				cfg.idxStore.at( t.fmPtr() ),
@@ -354,6 +1514,16 @@ void OscarSearchHCQRTextIndexCreator::run() {
 				aux.ci, cfg.idxStore,
 				aux.sgIndex->flags()
 			);
+			if (cfg.treeFormat == TF_SERIALIZED_HCQR) {
+				return hic::SerializedHcqr::fromCqr(cqr, aux.hcqrCtx).data();
+			}
+			else if (cfg.treeFormat == TF_SUCCINCT_HCQR) {
+				hic::SerializedHcqr shcqr = hic::SerializedHcqr::fromCqr(cqr, aux.hcqrCtx);
+				sserialize::UByteArrayAdapter result = hic::SuccinctHcqr::fromSerialized(shcqr).data();
+				passes.serializedBytes.fetch_add(shcqr.data().size(), std::memory_order_relaxed);
+				passes.succinctBytes.fetch_add(result.size(), std::memory_order_relaxed);
+				return result;
+			}
 			
 			HCQRPtr hcqr = HCQRPtr(new sserialize::spatial::dgg::impl::HCQRSpatialGrid (cqr, cqr.idxStore(), aux.sgIndex->sgPtr(), aux.sgi));
 			if (cfg.compactify) {
@@ -368,36 +1538,52 @@ void OscarSearchHCQRTextIndexCreator::run() {
 			}
 		}
 		
+		///Work of all passes is handed out in order, so passes overlap instead of waiting for each other
 		void operator()() {
-			std::size_t s = aux.sgIndex->trie().size();
+			std::size_t s = passes.trieSize;
 			while(true) {
-				std::size_t i = state.i.fetch_add(1, std::memory_order_relaxed);
-				if (i >= s) {
+				std::size_t gi = passes.i.fetch_add(1, std::memory_order_relaxed);
+				if (gi >= s*passes.states.size()) {
 					return;
 				}
-				state.pinfo(i);
+				passes.pinfo(gi);
+				//states are in the order of OscarSearchSgIndex::PayloadSource
+				uint8_t source = gi / s;
+				State & state = *passes.states[source];
+				std::size_t i = gi % s;
 				auto t = state.src.at(i);
 				sserialize::UByteArrayAdapter data(0, sserialize::MM_PROGRAM_MEMORY);
 				data.putUint8(t.types());
 				for(auto qt : pqt) {
-					if (t.types() & qt) {
-						data.put(sge2payload(t.type(qt)));
+					if (!(t.types() & qt)) {
+						continue;
+					}
+					if (cfg.treeFormat == TF_HCQR_SPATIAL_GRID) {
+						data.put(cachedSge2payload(t.type(qt)));
+					}
+					else {
+						putSerializedTree(t.type(qt), PayloadCache::Location{source, uint32_t(i), uint8_t(qt)}, data);
 					}
 				}
 				state.flush(i, std::move(data));
 			}
 		}
 		void flush();
-		Worker(CreationConfig & cfg, Aux const & aux, State & state) :
-		cfg(cfg), aux(aux), state(state)
+		Worker(CreationConfig & cfg, Aux const & aux, Passes & passes, PayloadCache & cache) :
+		cfg(cfg), aux(aux), passes(passes), cache(cache)
 		{}
 		Worker(Worker const & other) = default;
 	public:
 		CreationConfig & cfg;
 		Aux const & aux;
-		State & state;
+		Passes & passes;
+		PayloadCache & cache;
 	};
 	
+	if (cfg.treeFormat != TF_HCQR_SPATIAL_GRID && (cfg.compactify || cfg.compactTree)) {
+		throw sserialize::UnsupportedFeatureException("OscarSearchHCQRTextIndexCreator: compactified trees need TF_HCQR_SPATIAL_GRID");
+	}
+	
 	cfg.idxFactory.setDeduplication(false);
 	cfg.idxFactory.insert(cfg.idxStore);
 	cfg.idxFactory.setDeduplication(true);
@@ -408,43 +1594,59 @@ void OscarSearchHCQRTextIndexCreator::run() {
 	aux.ci = CellInfo::makeRc(aux.sgIndex);
 	aux.cellInfoPtr = sserialize::RCPtrWrapper<HCQRCellInfo>( new HCQRCellInfo(cfg.idxStore, aux.sgIndex->sgInfoPtr()) );
 	aux.sgi.reset( new SpatialGridInfoImp(aux.sgIndex->sgPtr(), aux.cellInfoPtr) );
+	aux.hcqrCtx = hic::Static::SerializedHcqrTextIndex::makeContext(*aux.sgIndex);
  
-	uint8_t payloadFlags = 0;
-	if (cfg.compactTree) {
-		payloadFlags = HCQRTextIndex::PayloadFlags::COMPACT_NODES;
+	if (cfg.treeFormat == TF_HCQR_SPATIAL_GRID) {
+		uint8_t payloadFlags = 0;
+		if (cfg.compactTree) {
+			payloadFlags = HCQRTextIndex::PayloadFlags::COMPACT_NODES;
+		}
+		else {
+			payloadFlags = HCQRTextIndex::PayloadFlags::FULL_TREE;
+		}
+		
+		cfg.dest.putUint8(3); //version
+		cfg.dest.putUint8(cfg.src.at(1)); //sq
+		cfg.dest.putUint8(payloadFlags);
+		cfg.dest.put( sserialize::UByteArrayAdapter(cfg.src, 2, aux.sgIndex->sgInfo().getSizeInBytes()) ); //sgInfo
+		cfg.dest.put( aux.sgIndex->trie().data() );
 	}
 	else {
-		payloadFlags = HCQRTextIndex::PayloadFlags::FULL_TREE;
+		//trie and grid are the ones of the source index
+		cfg.dest.putUint8(hic::Static::SerializedHcqrTextIndex::MetaData::version);
+		cfg.dest.putUint8(cfg.treeFormat);
 	}
 	
-	cfg.dest.putUint8(3); //version
-	cfg.dest.putUint8(cfg.src.at(1)); //sq
-	cfg.dest.putUint8(payloadFlags);
-	cfg.dest.put( sserialize::UByteArrayAdapter(cfg.src, 2, aux.sgIndex->sgInfo().getSizeInBytes()) ); //sgInfo
-	cfg.dest.put( aux.sgIndex->trie().data() );
-	
-	{
-		State state(cfg.dest, aux.sgIndex->m_mixed);
-		state.pinfo.begin(aux.sgIndex->trie().size(), "Processing mixed payload");
-		sserialize::ThreadPool::execute(Worker(cfg, aux, state), cfg.threads, sserialize::ThreadPool::CopyTaskTag());
-		state.ac.flush();
-		state.pinfo.end();
-	}
+	PayloadCache cache;
+	cache.maxBytes = cfg.payloadCacheBytes;
 	
 	{
-		State state(cfg.dest, aux.sgIndex->m_items);
-		state.pinfo.begin(aux.sgIndex->trie().size(), "Processing items payload");
-		sserialize::ThreadPool::execute(Worker(cfg, aux, state), cfg.threads, sserialize::ThreadPool::CopyTaskTag());
-		state.ac.flush();
-		state.pinfo.end();
+		Passes passes;
+		passes.trieSize = aux.sgIndex->trie().size();
+		//in the order of the payloads in dest
+		for(auto src : {&aux.sgIndex->m_mixed, &aux.sgIndex->m_items, &aux.sgIndex->m_regions}) {
+			passes.states.emplace_back( new State(*src, cfg.maxPendingPayloads) );
+		}
+		passes.pinfo.begin(passes.trieSize*passes.states.size(), "Processing mixed, items and regions payloads");
+		sserialize::ThreadPool::execute(Worker(cfg, aux, passes, cache), cfg.threads, sserialize::ThreadPool::CopyTaskTag());
+		passes.pinfo.end();
+		for(auto & state : passes.states) {
+			state->ac.flush();
+			cfg.dest.put(state->data);
+		}
+		if (cfg.treeFormat == TF_SUCCINCT_HCQR) {
+			std::cout << "Succinct trees need " << passes.succinctBytes << " Bytes, ";
+			std::cout << "their pre-order encoding would need " << passes.serializedBytes << " Bytes" << std::endl;
+		}
 	}
 	
-	{
-		State state(cfg.dest, aux.sgIndex->m_regions);
-		state.pinfo.begin(aux.sgIndex->trie().size(), "Processing regions payload");
-		sserialize::ThreadPool::execute(Worker(cfg, aux, state), cfg.threads, sserialize::ThreadPool::CopyTaskTag());
-		state.ac.flush();
-		state.pinfo.end();
+	if (cfg.payloadCacheBytes) {
+		std::cout << "Reused " << cache.hits << " of " << (cache.hits + cache.misses) << " serialized trees, ";
+		std::cout << cache.entries.size() << " trees with " << cache.bytes << " Bytes were cached";
+		if (cfg.treeFormat != TF_HCQR_SPATIAL_GRID) {
+			std::cout << ", reused trees are stored as references";
+		}
+		std::cout << std::endl;
 	}
 }
 